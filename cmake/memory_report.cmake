@@ -0,0 +1,22 @@
+# memory_report.cmake
+#
+# Adds post build step which prints flash and ram usage together with the amount of ram
+# recovered by placing constant tables into flash (PROGMEM). The build fails if the
+# application does not fit into the MCU.
+
+find_package(Python3 COMPONENTS Interpreter)
+
+if(Python3_FOUND)
+    add_custom_target(memory_report ALL
+        COMMAND ${Python3_EXECUTABLE} "${CMAKE_SOURCE_DIR}/tools/memory_report.py"
+            --elf "${OUTPUT_FULL_FILENAME_BASE}.elf"
+            --map "${OUTPUT_FULL_FILENAME_BASE}.map"
+            --size ${AVRSIZE}
+            --ram ${MCU_RAM_SIZE}
+            --flash ${MCU_FLASH_SIZE}
+        DEPENDS strip
+        VERBATIM
+    )
+else()
+    message(WARNING "Python3 not found, memory report is disabled")
+endif()
@@ -0,0 +1,44 @@
+# output_table.cmake
+#
+# Generates output_driver_freq_table.h (ocr and prescaler values for timer 2) from F_CPU and frequency range
+# set in system_settings.h. Next to the header there is a report with frequency error of every entry.
+# Generates output_driver_battery_table.h (control input battery compensation) from tools/battery_calibration.csv.
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(OUTPUT_TABLE_GENERATED_DIR "${CMAKE_BINARY_DIR}/generated")
+set(OUTPUT_TABLE_HEADER        "${OUTPUT_TABLE_GENERATED_DIR}/output_driver_freq_table.h")
+set(OUTPUT_TABLE_REPORT        "${OUTPUT_TABLE_GENERATED_DIR}/output_driver_freq_table_report.txt")
+set(OUTPUT_TABLE_SETTINGS      "${CMAKE_SOURCE_DIR}/source/app/system_settings.h")
+set(OUTPUT_TABLE_GENERATOR     "${CMAKE_SOURCE_DIR}/tools/generate_output_table.py")
+set(BATTERY_TABLE_HEADER       "${OUTPUT_TABLE_GENERATED_DIR}/output_driver_battery_table.h")
+set(BATTERY_TABLE_CALIBRATION  "${CMAKE_SOURCE_DIR}/tools/battery_calibration.csv")
+set(BATTERY_TABLE_GENERATOR    "${CMAKE_SOURCE_DIR}/tools/generate_battery_table.py")
+
+file(MAKE_DIRECTORY "${OUTPUT_TABLE_GENERATED_DIR}")
+
+add_custom_command(
+    OUTPUT "${OUTPUT_TABLE_HEADER}" "${OUTPUT_TABLE_REPORT}"
+    COMMAND ${Python3_EXECUTABLE} "${OUTPUT_TABLE_GENERATOR}"
+        --f-cpu ${F_CPU}
+        --settings "${OUTPUT_TABLE_SETTINGS}"
+        --header "${OUTPUT_TABLE_HEADER}"
+        --report "${OUTPUT_TABLE_REPORT}"
+    DEPENDS "${OUTPUT_TABLE_GENERATOR}" "${OUTPUT_TABLE_SETTINGS}"
+    COMMENT "Generating output driver frequency table"
+    VERBATIM
+)
+
+add_custom_command(
+    OUTPUT "${BATTERY_TABLE_HEADER}"
+    COMMAND ${Python3_EXECUTABLE} "${BATTERY_TABLE_GENERATOR}"
+        --calibration "${BATTERY_TABLE_CALIBRATION}"
+        --settings "${OUTPUT_TABLE_SETTINGS}"
+        --header "${BATTERY_TABLE_HEADER}"
+    DEPENDS "${BATTERY_TABLE_GENERATOR}" "${BATTERY_TABLE_CALIBRATION}" "${OUTPUT_TABLE_SETTINGS}"
+    COMMENT "Generating output driver battery compensation table"
+    VERBATIM
+)
+
+target_sources(${PROJECT_NAME} PRIVATE "${OUTPUT_TABLE_HEADER}" "${BATTERY_TABLE_HEADER}")
+target_include_directories(${PROJECT_NAME} PRIVATE "${OUTPUT_TABLE_GENERATED_DIR}")
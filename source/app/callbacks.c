@@ -17,10 +17,12 @@
 #include "display_driver.h"
 #include "gpio.h"
 #include "output_driver.h"
+#include "sequence_player.h"
 #include "timer_hal.h"
 
 // Target specific includes
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
 //===================================================================================================================//
 // Private macro defines                                                                                             //
@@ -48,6 +50,27 @@ void Adc_Done_Callback(volatile Adc_Channel_t *channel)
 
 void TimerHAL_Timer0_OverflowCallback()
 {
-    DisplayDriver_PerformMultiplex();
-    Gpio_ButtonsPerform();
+    // The tick takes hundreds of cycles, it runs with interrupts enabled, so the compare match interrupt of timer 2 is
+    // not delayed by it (OUTPUT_DRIVER_ISR_LATENCY_CYCLES). It ends long before the next overflow. The called functions
+    // access everything shared with the other interrupts atomically.
+    NONATOMIC_BLOCK(NONATOMIC_RESTORESTATE)
+    {
+        DisplayDriver_PerformMultiplex();
+        Gpio_ButtonsPerform();
+        OutputDriver_PerformSweep();
+        OutputDriver_PerformGate();
+        SequencePlayer_PerformTick();
+    }
+}
+
+void Gpio_FastStopCallback()
+{
+    OutputDriver_Disable();   // disconnects OC2
+    DcdcDriver_Enable(false); // disconnects OC1B and stops timer 1
+    GPIO_OUT_KEYS_DISABLE();  // both keys are driven low by their ports now
+}
+
+void TimerHAL_Timer2_CompareCallback()
+{
+    OutputDriver_PerformCompareMatch();
 }
\ No newline at end of file
@@ -9,6 +9,7 @@
  */
 
 // global target includes
+#include <avr/pgmspace.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -26,9 +27,6 @@
 // Compiler specific keywords
 #define __memx
 
-// String placeholders
-#define PSTR(s)                     (const __memx char *)(s)
-
 // Interrupt related
 #define ENABLE_GLOBAL_INTERRUPTS()  sei()
 #define DISABLE_GLOBAL_INTERRUPTS() cli()
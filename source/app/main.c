@@ -13,11 +13,15 @@
 #include "system_settings.h"
 
 #include "adc.h"
+#include "clock_hal.h"
 #include "dcdc_driver.h"
 #include "display_driver.h"
 #include "gpio.h"
 #include "logging.h"
 #include "output_driver.h"
+#include "scheduler.h"
+#include "sequence_player.h"
+#include "sequence_programs.h"
 #include "timer_hal.h"
 #include "uart_hal.h"
 #include "uart_printf.h"
@@ -25,6 +29,7 @@
 // Target specific includes
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 
 //===================================================================================================================//
@@ -48,6 +53,7 @@ typedef enum
     eMAIN_STATE_SELECT_FREQ,
     eMAIN_STATE_SHOW_VOLTAGE,
     eMAIN_STATE_WORK,
+    eMAIN_STATE_PROGRAM,
     eMAIN_STATE_ERROR,
 } Main_states_e;
 
@@ -58,6 +64,9 @@ Main_states_e nextState    = eMAIN_STATE_INIT;
 uint16_t gOutputVoltage     = DCDC_MIN_OUTPUT_VOLTAGE;
 uint8_t  gSelectedFrequency = 0;
 
+static Gpio_ButtonEvent_t buttonEvent;         // button event of the current loop
+static bool               controlInputChanged; // set by Main_TaskControlInput
+
 //===================================================================================================================//
 // App function declarations                                                                                         //
 //===================================================================================================================//
@@ -67,8 +76,31 @@ static Main_states_e Main_ShowLowBattery();
 static Main_states_e Main_SelectFreq();
 static Main_states_e Main_ShowVoltage();
 static Main_states_e Main_Work();
+static Main_states_e Main_Program();
 static Main_states_e Main_Error();
 
+static void Main_ReadButtonEvent();
+
+static void Main_TaskStateMachine();
+static void Main_TaskControlInput();
+static void Main_TaskMonitor();
+static bool Main_TaskDcdc();
+
+//===================================================================================================================//
+// Task table                                                                                                        //
+//===================================================================================================================//
+
+// Ordered by priority, the regulation of the dc-dc converter runs in the background (Main_TaskDcdc)
+const Scheduler_Task_t Main_Tasks[] PROGMEM = {
+    {SequencePlayer_Perform, MAIN_TASK_SEQUENCE_PERIOD, 0},
+    {DisplayDriver_PerformMessage, MAIN_TASK_DISPLAY_PERIOD, 0},
+    {Main_TaskControlInput, MAIN_TASK_CONTROL_INPUT_PERIOD, 1},
+    {Main_TaskStateMachine, MAIN_TASK_STATE_MACHINE_PERIOD, 2},
+    {Main_TaskMonitor, MAIN_TASK_MONITOR_PERIOD, 3},
+};
+
+#define MAIN_TASKS_COUNT (sizeof(Main_Tasks) / sizeof(Main_Tasks[0]))
+
 //===================================================================================================================//
 // main function                                                                                                  //
 //===================================================================================================================//
@@ -96,60 +128,131 @@ int main(void)
 
     OutputDriver_SetFrequency(100);
 
-    uint16_t timer        = 5; // ~ 10 ms
-    uint32_t oldTimestamp = timestamp;
+    // Init blocks for a while (self test, clock calibration), it is done before the tasks are started
+    currentState = Main_Init();
+
+    if(!Scheduler_Init(Main_Tasks, MAIN_TASKS_COUNT, Main_TaskDcdc))
+    {
+        // no task would run, the error is shown once
+        LOG_WARN("Invalid task table");
+        (void)Main_Error();
+    }
 
     while(1)
     {
-        // Main switching for application state machine
-        switch(currentState)
-        {
-        case eMAIN_STATE_INIT:
-            nextState = Main_Init();
-            break;
+        Scheduler_Perform();
+    }
+
+    return 0;
+}
+
+//===================================================================================================================//
+// Scheduler tasks                                                                                                   //
+//===================================================================================================================//
+
+/**
+ * @brief Runs one step of the application state machine.
+ */
+static void Main_TaskStateMachine()
+{
+    Main_ReadButtonEvent();
 
-        case eMAIN_STATE_SHOW_LOW_BAT:
-            nextState = Main_ShowLowBattery();
-            break;
+    // Main switching for application state machine
+    switch(currentState)
+    {
+    case eMAIN_STATE_INIT:
+        nextState = Main_Init();
+        break;
 
-        case eMAIN_STATE_SELECT_FREQ:
-            nextState = Main_SelectFreq();
-            break;
+    case eMAIN_STATE_SHOW_LOW_BAT:
+        nextState = Main_ShowLowBattery();
+        break;
 
-        case eMAIN_STATE_SHOW_VOLTAGE:
-            nextState = Main_ShowVoltage();
-            break;
+    case eMAIN_STATE_SELECT_FREQ:
+        nextState = Main_SelectFreq();
+        break;
 
-        case eMAIN_STATE_WORK:
-            nextState = Main_Work();
-            break;
+    case eMAIN_STATE_SHOW_VOLTAGE:
+        nextState = Main_ShowVoltage();
+        break;
 
-        case eMAIN_STATE_ERROR:
-            nextState = Main_Error();
-            break;
+    case eMAIN_STATE_WORK:
+        nextState = Main_Work();
+        break;
 
-        default:
-            nextState = eMAIN_STATE_ERROR;
-            break;
-        }
+    case eMAIN_STATE_PROGRAM:
+        nextState = Main_Program();
+        break;
+
+    case eMAIN_STATE_ERROR:
+        nextState = Main_Error();
+        break;
+
+    default:
+        nextState = eMAIN_STATE_ERROR;
+        break;
+    }
+
+    // added second buffer for states due to better working of function Main_IsNewState()
+    oldState     = currentState;
+    currentState = nextState;
+}
+
+/**
+ * @brief Tracks the knob, the change is kept until the state which uses it takes it.
+ */
+static void Main_TaskControlInput()
+{
+    if(OutputDriver_IsControlInputChanged())
+    {
+        controlInputChanged = true;
+    }
+}
 
-        // added second buffer for states due to better working of function Main_IsNewState()
-        oldState     = currentState;
-        currentState = nextState;
+/**
+ * @brief Regulates the dc-dc converter whenever no task is due, as often as the busy loop did before.
+ *
+ * The gains of the regulator are tuned to this rate. The cpu sleeps only while the converter is disabled, the regulator
+ * is still called on each wake up then.
+ *
+ * @return true if the converter is enabled
+ */
+static bool Main_TaskDcdc()
+{
+    DcdcDriver_Perform();
+
+    return DcdcDriver_IsEnabled();
+}
 
-        while(timer != 0)
+/**
+ * @brief Reports tasks which missed their releases since the last report, the statistics are reset then.
+ *
+ * The log blocks on the uart, the reset makes the scheduler skip the overruns caused by the report itself.
+ */
+static void Main_TaskMonitor()
+{
+    Scheduler_Statistics_t statistics;
+    bool                   overrun = false;
+
+    for(uint8_t i = 0; Scheduler_GetStatistics(i, &statistics); i++)
+    {
+        LOG_DEBUG("Task %u: %u overruns, wcet %lu us",
+                  i,
+                  statistics.overruns,
+                  statistics.wcet * TIMER_HAL_FINE_TIME_US);
+        if(statistics.overruns != 0)
         {
-            if(oldTimestamp != timestamp)
-            {
-                timer--;
-                oldTimestamp = timestamp;
-            }
-            DcdcDriver_Perform(); // Do this function always
+            LOG_WARN("Task %u missed %u releases, wcet %lu us",
+                     i,
+                     statistics.overruns,
+                     statistics.wcet * TIMER_HAL_FINE_TIME_US);
+            overrun = true;
         }
-        timer = 5;
     }
-
-    return 0;
+    if(overrun)
+    {
+        Scheduler_ResetStatistics();
+    }
 }
 
 //===================================================================================================================//
@@ -161,6 +264,35 @@ static bool Main_IsNewState()
     return (currentState != oldState) ? true : false;
 }
 
+/**
+ * @brief Takes one button event per loop, any press wakes the display up from dimming.
+ *
+ * Events which the current state does not check are consumed, so they can not act later in another state.
+ */
+static void Main_ReadButtonEvent()
+{
+    uint8_t lost = Gpio_GetLostEvents();
+
+    if(lost != 0)
+    {
+        LOG_WARN("%u button events lost", lost);
+    }
+
+    if(!Gpio_GetEvent(&buttonEvent))
+    {
+        buttonEvent.event = eBUTTON_EVENT_NONE;
+    }
+    else if(buttonEvent.event == eBUTTON_EVENT_PRESSED)
+    {
+        DisplayDriver_WakeUp();
+    }
+}
+
+static bool Main_IsButtonEvent(Gpio_ButtonInstance_e button, Gpio_ButtonEvent_e event)
+{
+    return ((buttonEvent.button == button) && (buttonEvent.event == event)) ? true : false;
+}
+
 //===================================================================================================================//
 // Main state init functions                                                                                         //
 //===================================================================================================================//
@@ -169,14 +301,10 @@ static void MainInit_BlinkLed()
 {
     for(uint8_t i = 0; i < 4; i++)
     {
-        GPIO_OUT_LED_A_ENABLE();
-        GPIO_OUT_LED_B_ENABLE();
-        GPIO_OUT_LED_C_ENABLE();
+        GPIO_OUT_LEDS_ENABLE();
         _delay_ms(250);
 
-        GPIO_OUT_LED_A_DISABLE();
-        GPIO_OUT_LED_B_DISABLE();
-        GPIO_OUT_LED_C_DISABLE();
+        GPIO_OUT_LEDS_DISABLE();
         _delay_ms(250);
     }
 }
@@ -191,7 +319,22 @@ static Main_states_e Main_Init()
 
     // Hal initialization
     Gpio_InitAll();
+    ClockHAL_LoadCalibration();
     Uart_InitUart();
+    if(!(GPIO_IN_GET_SWITCH_A()) && !(GPIO_IN_GET_SWITCH_B()))
+    {
+        // Both buttons held at power on, the host sends 0x55 characters for the clock calibration
+        int16_t error;
+
+        if(ClockHAL_Calibrate(&error))
+        {
+            LOG_WARN("Clock calibrated, OSCCAL %u, error %d (0.01 %%)", OSCCAL, error);
+        }
+        else
+        {
+            LOG_WARN("Clock calibration failed, no data from the host");
+        }
+    }
     Adc_Init();
     TimerHAL_InitTimer_0(&hTimer0); // sysTimer
     TimerHAL_InitTimer_1(&hTimer1); // Dcdc Timer
@@ -200,6 +343,7 @@ static Main_states_e Main_Init()
     // Driver initialization
     LOG_DEBUG("====== APPLICATION START ======\n");
     DcdcDriver_Init();
+    DisplayDriver_Init();
 
     // Starting peripherals
     ENABLE_GLOBAL_INTERRUPTS();
@@ -218,7 +362,7 @@ static Main_states_e Main_Init()
     }
 
     // Test is Ok;
-    DisplayDriver_SetNumber(voltage / 100);
+    DisplayDriver_SetFixed(voltage, 3);
     MainInit_BlinkLed();
     Adc_Perform();
 
@@ -238,50 +382,21 @@ static Main_states_e Main_ShowLowBattery()
 {
     Main_states_e   state = eMAIN_STATE_SHOW_LOW_BAT;
     static uint16_t timer = 300; // ~3s
-    typedef enum
-    {
-        eChangeToLow,
-        eChangeToBa,
-        eWaitForDisplayOff,
-        eWaitForDisplayOn
-    } localState_e;
-    static localState_e localState;
-    static localState_e prevLocalState;
+    static bool     showLow;
+    bool            on;
 
     if(Main_IsNewState())
     {
-        localState = eChangeToLow;
+        showLow = true;
+        DisplayDriver_SetSpecial(eDISPLAY_DIGIT_BATTERY_LOW);
         DisplayDriver_SetMode(eDISPLAY_MODE_BLINKING);
     }
 
-    switch(localState)
+    // "Lo" and "bA" are swapped while the display is off
+    if(DisplayDriver_IsBlinkPhaseChanged(&on) && !on)
     {
-    case eChangeToLow:
-        DisplayDriver_SetSpecial(eDISPLAY_DIGIT_BATTERY_LOW);
-        prevLocalState = eChangeToLow;
-        localState     = eWaitForDisplayOn;
-        break;
-    case eChangeToBa:
-        DisplayDriver_SetSpecial(eDISPLAY_DIGIT_BATTERY);
-        prevLocalState = eChangeToBa;
-        localState     = eWaitForDisplayOn;
-        break;
-    case eWaitForDisplayOff:
-        if(DisplayDriver_IsPowered() == 0)
-        {
-            if(prevLocalState == eChangeToBa)
-                localState = eChangeToLow;
-            else
-                localState = eChangeToBa;
-        }
-        break;
-    case eWaitForDisplayOn:
-        if(DisplayDriver_IsPowered())
-            localState = eWaitForDisplayOff;
-        break;
-    default:
-        state = eMAIN_STATE_ERROR;
-        break;
+        showLow = !showLow;
+        DisplayDriver_SetSpecial(showLow ? eDISPLAY_DIGIT_BATTERY_LOW : eDISPLAY_DIGIT_BATTERY);
     }
 
     timer--;
@@ -299,7 +414,9 @@ static Main_states_e Main_ShowLowBattery()
 /**
  * @brief
  *
- * @return eMAIN_STATE_SELECT_FREQ, eMAIN_STATE_SHOW_VOLTAGE, eMAIN_STATE_WORK, eMAIN_STATE_ERROR
+ * Knob at 0 with button A starts the stored program instead of the fixed frequency.
+ *
+ * @return eMAIN_STATE_SELECT_FREQ, eMAIN_STATE_SHOW_VOLTAGE, eMAIN_STATE_WORK, eMAIN_STATE_PROGRAM, eMAIN_STATE_ERROR
  */
 static Main_states_e Main_SelectFreq()
 {
@@ -311,18 +428,23 @@ static Main_states_e Main_SelectFreq()
         GPIO_OUT_LED_A_ENABLE();
     }
 
-    gSelectedFrequency = OutputDriver_GetControlInput();
-    DisplayDriver_SetNumber(gSelectedFrequency);
+    // Knob is tracked with hysteresis, the display is updated only when the value really changes
+    if(Main_IsNewState() || controlInputChanged)
+    {
+        controlInputChanged = false;
+        gSelectedFrequency  = OutputDriver_GetControlInput();
+        DisplayDriver_SetNumber(gSelectedFrequency);
+    }
 
     // Go to work
-    if(Gpio_GetButton(GPIO_BUTTON_A) == eBUTTON_STATUS_PRESSED)
+    if(Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_PRESSED))
     {
         GPIO_OUT_LED_A_DISABLE();
-        state = eMAIN_STATE_WORK;
+        state = (gSelectedFrequency == 0) ? eMAIN_STATE_PROGRAM : eMAIN_STATE_WORK;
     }
 
     // Change output voltage
-    if(Gpio_GetButton(GPIO_BUTTON_B) == eBUTTON_STATUS_PRESSED)
+    if(Main_IsButtonEvent(eGPIO_BUTTON_B, eBUTTON_EVENT_PRESSED))
     {
         state = eMAIN_STATE_SHOW_VOLTAGE;
     }
@@ -335,28 +457,59 @@ static Main_states_e Main_SelectFreq()
 //===================================================================================================================//
 
 /**
- * @brief
+ * @brief Sets the output voltage.
+ *
+ * Press of button B increases the voltage by a coarse step and wraps around. Holding button B or A increases or
+ * decreases it by fine steps, double click of button A sets the minimum.
  *
  * @return eMAIN_STATE_SELECT_FREQ,
  */
 static Main_states_e Main_ShowVoltage()
 {
-    Main_states_e   state = eMAIN_STATE_SHOW_VOLTAGE;
+    Main_states_e   state   = eMAIN_STATE_SHOW_VOLTAGE;
     static uint16_t timer;
+    bool            changed = false;
 
     // Increase again voltage if button was pressed in this state
-    if(Main_IsNewState() || (Gpio_GetButton(GPIO_BUTTON_B) == eBUTTON_STATUS_PRESSED))
+    if(Main_IsNewState() || Main_IsButtonEvent(eGPIO_BUTTON_B, eBUTTON_EVENT_PRESSED))
     {
-        timer = 150; // ~1.5s
-        gOutputVoltage += 5000;
-        DisplayDriver_SetMode(eDISPLAY_MODE_BLINKING);
+        changed = true;
+        gOutputVoltage += DCDC_VOLTAGE_STEP;
 
         if(gOutputVoltage > DCDC_MAX_OUTPUT_VOLTAGE)
             gOutputVoltage = DCDC_MIN_OUTPUT_VOLTAGE;
-        // TODO:: move votlages to system settings
     }
 
-    DisplayDriver_SetNumber(gOutputVoltage / 1000);
+    // Fine steps while a button is held, without wrapping around
+    if(Main_IsButtonEvent(eGPIO_BUTTON_B, eBUTTON_EVENT_LONG_PRESS) ||
+       Main_IsButtonEvent(eGPIO_BUTTON_B, eBUTTON_EVENT_REPEAT))
+    {
+        changed        = true;
+        gOutputVoltage = (gOutputVoltage > (DCDC_MAX_OUTPUT_VOLTAGE - DCDC_VOLTAGE_FINE_STEP))
+                             ? DCDC_MAX_OUTPUT_VOLTAGE
+                             : (gOutputVoltage + DCDC_VOLTAGE_FINE_STEP);
+    }
+    if(Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_LONG_PRESS) ||
+       Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_REPEAT))
+    {
+        changed        = true;
+        gOutputVoltage = (gOutputVoltage < (DCDC_MIN_OUTPUT_VOLTAGE + DCDC_VOLTAGE_FINE_STEP))
+                             ? DCDC_MIN_OUTPUT_VOLTAGE
+                             : (gOutputVoltage - DCDC_VOLTAGE_FINE_STEP);
+    }
+    if(Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_DOUBLE_CLICK))
+    {
+        changed        = true;
+        gOutputVoltage = DCDC_MIN_OUTPUT_VOLTAGE;
+    }
+
+    if(changed)
+    {
+        timer = 150; // ~1.5s
+        DisplayDriver_SetMode(eDISPLAY_MODE_BLINKING);
+    }
+
+    DisplayDriver_SetFixed(gOutputVoltage, 3);
 
     timer--;
     if(timer == 0)
@@ -388,11 +541,13 @@ static Main_states_e Main_Work()
         OutputDriver_SetFrequency(gSelectedFrequency);
         OutputDriver_Enable();
         GPIO_OUT_LED_B_ENABLE();
+        Gpio_FastStopArm(true);
     }
 
-    // Exit state
-    if(Gpio_GetButton(GPIO_BUTTON_A) == eBUTTON_STATUS_PRESSED)
+    // Exit state, the outputs are already stopped from INT0 when the fast stop triggered
+    if(Gpio_IsFastStopped() || Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_PRESSED))
     {
+        Gpio_FastStopArm(false);
         DcdcDriver_Enable(false);
         OutputDriver_Disable();
         GPIO_OUT_LED_B_DISABLE();
@@ -406,6 +561,76 @@ static Main_states_e Main_Work()
 // Application functions                                                                                             //
 //===================================================================================================================//
 
+/**
+ * @brief Plays the stored program, steps are switched by the sequence player from the system tick.
+ *
+ * Display shows the remaining time, in seconds below 100 s, otherwise in minutes ("--" above 99 minutes). Button A
+ * stops the program, "End" is shown only when the program has run to its end.
+ *
+ * @return eMAIN_STATE_PROGRAM, eMAIN_STATE_SELECT_FREQ, eMAIN_STATE_ERROR
+ */
+static Main_states_e Main_Program()
+{
+    Main_states_e             state = eMAIN_STATE_PROGRAM;
+    SequencePlayer_Progress_t progress;
+    uint32_t                  seconds;
+    uint32_t                  minutes;
+
+    // Enter state
+    if(Main_IsNewState())
+    {
+        OutputDriver_Init();
+        if(!SequencePlayer_Start(sequenceProgram_Default, SEQUENCE_PROGRAM_DEFAULT_STEPS, eSEQUENCE_MEMORY_FLASH))
+        {
+            return eMAIN_STATE_ERROR;
+        }
+        GPIO_OUT_LED_B_ENABLE();
+    }
+
+    // Exit state
+    if(Main_IsButtonEvent(eGPIO_BUTTON_A, eBUTTON_EVENT_PRESSED))
+    {
+        SequencePlayer_Stop();
+    }
+
+    SequencePlayer_GetProgress(&progress);
+
+    if(!progress.running)
+    {
+        // only the program which has run to its end is announced, not the one stopped by the button
+        if(progress.finished)
+        {
+            if(progress.lateSteps != 0)
+            {
+                LOG_WARN("Program finished, %u steps switched late", progress.lateSteps);
+            }
+            DisplayDriver_ShowMessage(PSTR("End"), true, eDISPLAY_PRIORITY_NORMAL);
+        }
+        GPIO_OUT_LED_B_DISABLE();
+        state = eMAIN_STATE_SELECT_FREQ;
+    }
+    else
+    {
+        seconds = (progress.remainingTime + 9) / 10;
+        if(seconds < 100)
+        {
+            DisplayDriver_SetNumber((uint8_t)seconds);
+        }
+        else
+        {
+            // above 99 minutes the value does not fit, it is shown as "--"
+            minutes = (seconds + 59) / 60;
+            DisplayDriver_SetFixed((minutes > 100) ? 100 : (uint16_t)minutes, 0);
+        }
+    }
+
+    return state;
+}
+
+//===================================================================================================================//
+// Application functions                                                                                             //
+//===================================================================================================================//
+
 /**
  * @brief
  *
@@ -0,0 +1,224 @@
+/**
+ * @file scheduler.c
+ * @addtogroup Level_x_App
+ *
+ * @brief Source file for cooperative tick scheduler
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+// File specific includes
+#include "scheduler.h"
+
+#include "global_defines.h"
+#include "system_settings.h"
+
+#include "timer_hal.h"
+
+// Target specific includes
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+
+//===================================================================================================================//
+// Private macro defines                                                                                             //
+//===================================================================================================================//
+
+// Task table is placed in flash, use only these macros to read it
+#define SCHEDULER_GET_FUNCTION(index)                                                                                  \
+    ((void (*)())(uintptr_t)pgm_read_word(&hScheduler.pTasks[(index)].pFunction))
+#define SCHEDULER_GET_PERIOD(index)   pgm_read_byte(&hScheduler.pTasks[(index)].period)
+#define SCHEDULER_GET_PHASE(index)    pgm_read_byte(&hScheduler.pTasks[(index)].phase)
+
+//===================================================================================================================//
+// Private definitions                                                                                               //
+//===================================================================================================================//
+
+typedef struct
+{
+    uint16_t               release; // system tick of the next release
+    bool                   resync;  // the next start does not count an overrun
+    Scheduler_Statistics_t statistics;
+} Scheduler_TaskState_t;
+
+typedef struct
+{
+    const Scheduler_Task_t *pTasks;
+    uint8_t                 tasksCount;
+    bool (*pBackground)();
+    Scheduler_TaskState_t state[SCHEDULER_MAX_TASKS];
+} Scheduler_t;
+
+//===================================================================================================================//
+// Private variables                                                                                                 //
+//===================================================================================================================//
+
+Scheduler_t hScheduler;
+
+//===================================================================================================================//
+// Private functions                                                                                                 //
+//===================================================================================================================//
+
+static uint16_t Scheduler_privGetTicks()
+{
+    uint16_t ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = (uint16_t)timestamp;
+    }
+
+    return ticks;
+}
+
+/**
+ * @brief Sleeps until the next interrupt, if the system tick has not come in the meantime.
+ *
+ * Interrupts are enabled by the instruction right before the sleep, so an interrupt can not come between the check
+ * and the sleep without waking the cpu up.
+ */
+static void Scheduler_privSleep(uint16_t now)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+    DISABLE_GLOBAL_INTERRUPTS();
+    if((uint16_t)timestamp == now)
+    {
+        sleep_enable();
+        ENABLE_GLOBAL_INTERRUPTS();
+        sleep_cpu();
+        sleep_disable();
+    }
+    ENABLE_GLOBAL_INTERRUPTS();
+}
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+/**
+ * @brief Initializes the scheduler with the task table, the phases are counted from now.
+ *
+ * @param pTasks task table in flash, ordered by priority
+ * @param tasksCount number of tasks, up to SCHEDULER_MAX_TASKS
+ * @param pBackground task called whenever no task is due, it returns false if the cpu can sleep; NULL if not used
+ * @return true if the table is valid, false otherwise
+ */
+bool Scheduler_Init(const Scheduler_Task_t *pTasks, uint8_t tasksCount, bool (*pBackground)())
+{
+    uint16_t now = Scheduler_privGetTicks();
+
+    if(tasksCount > SCHEDULER_MAX_TASKS)
+    {
+        return false;
+    }
+
+    hScheduler.pTasks      = pTasks;
+    hScheduler.tasksCount  = tasksCount;
+    hScheduler.pBackground = pBackground;
+
+    for(uint8_t i = 0; i < tasksCount; i++)
+    {
+        uint8_t period = SCHEDULER_GET_PERIOD(i);
+        uint8_t phase  = SCHEDULER_GET_PHASE(i);
+
+        if((period == 0) || (phase >= period))
+        {
+            hScheduler.tasksCount = 0;
+            return false;
+        }
+        hScheduler.state[i].release = now + phase;
+    }
+    Scheduler_ResetStatistics();
+
+    return true;
+}
+
+/**
+ * @brief Runs the first due task of the table, call it from the main loop.
+ *
+ * A task which did not start until its next release counts an overrun, the missed releases are skipped and the phase
+ * is kept. If no task is due, the background task runs, the cpu sleeps if there is no work for it.
+ */
+void Scheduler_Perform()
+{
+    uint16_t now = Scheduler_privGetTicks();
+
+    for(uint8_t i = 0; i < hScheduler.tasksCount; i++)
+    {
+        Scheduler_TaskState_t *pState = &hScheduler.state[i];
+        uint16_t               late   = now - pState->release;
+        uint8_t                period;
+        uint16_t               start;
+        uint16_t               duration;
+
+        // not released yet
+        if((int16_t)late < 0)
+        {
+            continue;
+        }
+
+        period = SCHEDULER_GET_PERIOD(i);
+        if(late >= period)
+        {
+            if((pState->statistics.overruns != UINT8_MAX) && !pState->resync)
+            {
+                pState->statistics.overruns++;
+            }
+            late %= period;
+        }
+        pState->resync  = false;
+        pState->release = now - late + period;
+
+        start = TimerHAL_GetFineTime();
+        SCHEDULER_GET_FUNCTION(i)();
+        duration = TimerHAL_GetFineTime() - start;
+
+        if(duration > pState->statistics.wcet)
+        {
+            pState->statistics.wcet = duration;
+        }
+        return;
+    }
+
+    if((hScheduler.pBackground == NULL) || !hScheduler.pBackground())
+    {
+        Scheduler_privSleep(now);
+    }
+}
+
+/**
+ * @brief Reads statistics of one task.
+ *
+ * @param task index of the task in the table
+ * @param pStatistics place for the statistics
+ * @return true if the task exists, false otherwise
+ */
+bool Scheduler_GetStatistics(uint8_t task, Scheduler_Statistics_t *pStatistics)
+{
+    if(task >= hScheduler.tasksCount)
+    {
+        return false;
+    }
+    *pStatistics = hScheduler.state[task].statistics;
+
+    return true;
+}
+
+/**
+ * @brief Resets statistics of all tasks.
+ *
+ * The next start of each task does not count an overrun, so a delay made by the caller (e.g. a log which reports the
+ * statistics) is not counted again.
+ */
+void Scheduler_ResetStatistics()
+{
+    for(uint8_t i = 0; i < hScheduler.tasksCount; i++)
+    {
+        hScheduler.state[i].resync              = true;
+        hScheduler.state[i].statistics.overruns = 0;
+        hScheduler.state[i].statistics.wcet     = 0;
+    }
+}
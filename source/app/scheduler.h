@@ -0,0 +1,64 @@
+/**
+ * @file scheduler.h
+ * @addtogroup Level_x_App
+ *
+ * @brief Header file for cooperative tick scheduler
+ *
+ * Tasks are given by a static table, each task runs with its period and phase in system ticks. Tasks are not
+ * preempted, from the due tasks the first one in the table runs first. When no task is due, the cpu sleeps until the
+ * next interrupt.
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+// File specific includes
+#include "global_defines.h"
+#include "system_settings.h"
+
+// Target specific includes
+
+//===================================================================================================================//
+// Public macro defines                                                                                              //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public definitions                                                                                                //
+//===================================================================================================================//
+
+/**
+ * @brief One task of the table, the table is placed in flash and ordered by priority (the highest first)
+ */
+typedef struct
+{
+    void (*pFunction)();
+    uint8_t period; // system ticks
+    uint8_t phase;  // system ticks after the start of the scheduler, smaller than the period
+} Scheduler_Task_t;
+
+typedef struct
+{
+    uint8_t  overruns; // releases missed as the task did not start until its next release, saturates
+    uint16_t wcet;     // worst case execution time in TIMER_HAL_FINE_TIME_US
+} Scheduler_Statistics_t;
+
+//===================================================================================================================//
+// Public variables                                                                                                  //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+bool Scheduler_Init(const Scheduler_Task_t *pTasks, uint8_t tasksCount, bool (*pBackground)());
+
+void Scheduler_Perform();
+
+bool Scheduler_GetStatistics(uint8_t task, Scheduler_Statistics_t *pStatistics);
+
+void Scheduler_ResetStatistics();
+
+#endif // SCHEDULER_H_
@@ -0,0 +1,314 @@
+/**
+ * @file sequence_player.c
+ * @addtogroup Level_x_App
+ *
+ * @brief Source file for sequence player
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+// File specific includes
+#include "sequence_player.h"
+
+#include "global_defines.h"
+#include "system_settings.h"
+
+#include "dcdc_driver.h"
+#include "logging.h"
+#include "output_driver.h"
+#include "timer_hal.h"
+
+// Target specific includes
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+
+//===================================================================================================================//
+// Private macro defines                                                                                             //
+//===================================================================================================================//
+
+#define SEQUENCE_PLAYER_TIME_UNIT_US 100000UL // 0.1 s
+
+//===================================================================================================================//
+// Private definitions                                                                                               //
+//===================================================================================================================//
+
+typedef struct
+{
+    OutputDriver_Setting_t setting;
+    uint16_t               duration;
+    uint16_t               voltage;
+} SequencePlayer_Prepared_t;
+
+typedef struct
+{
+    const SequencePlayer_Step_t *pSteps;
+    SequencePlayer_Memory_e      memory;
+    uint8_t                      stepsCount;
+    volatile uint8_t             step;
+    volatile uint16_t            stepTime;      // remaining time of the running step, 0.1 s
+    volatile uint32_t            remainingTime; // remaining time of the program, 0.1 s
+    uint32_t                     tickAccum;     // us
+    SequencePlayer_Prepared_t    next;
+    volatile bool                nextReady;
+    volatile bool                late;
+    volatile uint8_t             lateSteps;
+    volatile bool                running;
+    volatile bool                finished; // the last step has run to its end
+    uint8_t                      loggedStep;
+} SequencePlayer_t;
+
+//===================================================================================================================//
+// Private variables                                                                                                 //
+//===================================================================================================================//
+
+SequencePlayer_t hPlayer;
+
+//===================================================================================================================//
+// Private functions                                                                                                 //
+//===================================================================================================================//
+
+static void SequencePlayer_privReadStep(uint8_t index, SequencePlayer_Step_t *pStep)
+{
+    if(hPlayer.memory == eSEQUENCE_MEMORY_EEPROM)
+    {
+        eeprom_read_block(pStep, &hPlayer.pSteps[index], sizeof(SequencePlayer_Step_t));
+    }
+    else
+    {
+        memcpy_P(pStep, &hPlayer.pSteps[index], sizeof(SequencePlayer_Step_t));
+    }
+}
+
+static void SequencePlayer_privPrepareStep(uint8_t index, SequencePlayer_Prepared_t *pPrepared)
+{
+    SequencePlayer_Step_t step;
+
+    SequencePlayer_privReadStep(index, &step);
+    OutputDriver_PrepareFrequencyHz(step.frequency, &pPrepared->setting);
+    pPrepared->duration = step.duration;
+    pPrepared->voltage  = step.voltage;
+}
+
+/**
+ * @brief Switches hardware to the prepared step. Call with interrupts disabled.
+ */
+static void SequencePlayer_privApplyStep(const SequencePlayer_Prepared_t *pPrepared)
+{
+    OutputDriver_ApplySetting(&pPrepared->setting);
+    DcdcDriver_SetVoltage(pPrepared->voltage);
+    hPlayer.stepTime = pPrepared->duration;
+}
+
+/**
+ * @brief Stops the program, output and DC-DC converter are disabled. Call with interrupts disabled.
+ *
+ * @param finished true if the last step has run to its end, false if the program was stopped
+ */
+static void SequencePlayer_privFinish(bool finished)
+{
+    OutputDriver_Disable();
+    DcdcDriver_Enable(false);
+    hPlayer.running       = false;
+    hPlayer.finished      = finished;
+    hPlayer.nextReady     = false;
+    hPlayer.remainingTime = 0;
+    hPlayer.stepTime      = 0;
+}
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+/**
+ * @brief Starts a program.
+ *
+ * The first step is applied immediately, output and DC-DC converter are enabled. Timer 2 must be started before
+ * (OutputDriver_Init). Running program is restarted.
+ *
+ * @param pSteps address of the step table in flash or eeprom
+ * @param stepsCount number of steps
+ * @param memory memory where the table is stored
+ * @return false if there is nothing to play
+ */
+bool SequencePlayer_Start(const SequencePlayer_Step_t *pSteps, uint8_t stepsCount, SequencePlayer_Memory_e memory)
+{
+    SequencePlayer_Prepared_t first;
+    SequencePlayer_Step_t     step;
+    uint32_t                  totalTime = 0;
+
+    if((pSteps == NULL) || (stepsCount == 0))
+    {
+        return false;
+    }
+
+    SequencePlayer_Stop();
+
+    hPlayer.pSteps     = pSteps;
+    hPlayer.memory     = memory;
+    hPlayer.stepsCount = stepsCount;
+
+    for(uint8_t i = 0; i < stepsCount; i++)
+    {
+        SequencePlayer_privReadStep(i, &step);
+        totalTime += step.duration;
+    }
+
+    SequencePlayer_privPrepareStep(0, &first);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        SequencePlayer_privApplyStep(&first);
+        hPlayer.step          = 0;
+        hPlayer.remainingTime = totalTime;
+        hPlayer.tickAccum     = 0;
+        hPlayer.nextReady     = false;
+        hPlayer.late          = false;
+        hPlayer.lateSteps     = 0;
+        hPlayer.loggedStep    = 0;
+        hPlayer.running       = true;
+        hPlayer.finished      = false;
+    }
+    DcdcDriver_Enable(true);
+    OutputDriver_Enable();
+
+    LOG_DEBUG("Program started, %u steps, %lu s", stepsCount, totalTime / 10);
+
+    return true;
+}
+
+/**
+ * @brief Stops running program, output and DC-DC converter are disabled.
+ */
+void SequencePlayer_Stop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(hPlayer.running)
+        {
+            SequencePlayer_privFinish(false);
+        }
+    }
+}
+
+bool SequencePlayer_IsRunning()
+{
+    return hPlayer.running;
+}
+
+void SequencePlayer_GetProgress(SequencePlayer_Progress_t *pProgress)
+{
+    ASSERT(pProgress != NULL);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pProgress->step          = hPlayer.step;
+        pProgress->remainingTime = hPlayer.remainingTime;
+        pProgress->lateSteps     = hPlayer.lateSteps;
+        pProgress->running       = hPlayer.running;
+        pProgress->finished      = hPlayer.finished;
+    }
+    pProgress->stepsCount = hPlayer.stepsCount;
+}
+
+/**
+ * @brief Prepares the next step in advance, so the tick only stages it for the hardware.
+ *
+ * Call it from the main loop. Calculation of the timer settings takes too long for the interrupt.
+ */
+void SequencePlayer_Perform()
+{
+    SequencePlayer_Prepared_t next;
+    uint8_t                   step;
+
+    if(!hPlayer.running || hPlayer.nextReady)
+    {
+        return;
+    }
+
+    step = hPlayer.step;
+    if(step != hPlayer.loggedStep)
+    {
+        LOG_DEBUG("Program step %u/%u, %lu Hz", step + 1, hPlayer.stepsCount, OutputDriver_GetFrequencyHz());
+        hPlayer.loggedStep = step;
+    }
+
+    if((uint8_t)(step + 1) >= hPlayer.stepsCount)
+    {
+        return;
+    }
+
+    SequencePlayer_privPrepareStep(step + 1, &next);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Program could have been stopped or restarted in the meantime
+        if(hPlayer.running && (hPlayer.step == step))
+        {
+            hPlayer.next      = next;
+            hPlayer.nextReady = true;
+        }
+    }
+}
+
+/**
+ * @brief Counts the time of the running step and switches to the next one.
+ *
+ * Call it from the system tick. Steps are switched on the tick boundary, so the jitter of the main loop does not
+ * affect the timing. The switch only stages the prepared settings, the timer takes them at its next compare match
+ * and nothing is waited for here. When the next step is not prepared yet, the switch is delayed to the next tick and
+ * counted as a late step.
+ */
+void SequencePlayer_PerformTick()
+{
+    if(!hPlayer.running)
+    {
+        return;
+    }
+
+    hPlayer.tickAccum += TIMER_HAL_SYSTICK_PERIOD_US;
+    if(hPlayer.tickAccum >= SEQUENCE_PLAYER_TIME_UNIT_US)
+    {
+        hPlayer.tickAccum -= SEQUENCE_PLAYER_TIME_UNIT_US;
+        if(hPlayer.remainingTime != 0)
+        {
+            hPlayer.remainingTime--;
+        }
+        if(hPlayer.stepTime != 0)
+        {
+            hPlayer.stepTime--;
+        }
+    }
+
+    if(hPlayer.stepTime != 0)
+    {
+        return;
+    }
+
+    if(!hPlayer.nextReady && ((uint8_t)(hPlayer.step + 1) < hPlayer.stepsCount))
+    {
+        if(!hPlayer.late)
+        {
+            hPlayer.lateSteps++;
+            hPlayer.late = true;
+        }
+        return;
+    }
+
+    // the tick runs with interrupts enabled, the fast stop interrupt switches the same outputs
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if((uint8_t)(hPlayer.step + 1) >= hPlayer.stepsCount)
+        {
+            SequencePlayer_privFinish(true);
+        }
+        else
+        {
+            SequencePlayer_privApplyStep(&hPlayer.next);
+            hPlayer.step++;
+            hPlayer.nextReady = false;
+            hPlayer.late      = false;
+        }
+    }
+}
@@ -0,0 +1,77 @@
+/**
+ * @file sequence_player.h
+ * @addtogroup Level_x_App
+ *
+ * @brief Header file for sequence player
+ *
+ * Sequence player executes a treatment program made of (frequency, duration, voltage) steps. The steps are switched
+ * from the system tick, the main loop only prepares the next step in advance.
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+#ifndef SEQUENCE_PLAYER_H_
+#define SEQUENCE_PLAYER_H_
+
+// File specific includes
+#include "global_defines.h"
+#include "system_settings.h"
+
+// Target specific includes
+
+//===================================================================================================================//
+// Public macro defines                                                                                              //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public definitions                                                                                                //
+//===================================================================================================================//
+
+typedef enum
+{
+    eSEQUENCE_MEMORY_FLASH,
+    eSEQUENCE_MEMORY_EEPROM
+} SequencePlayer_Memory_e;
+
+/**
+ * @brief One step of the program, as stored in flash or eeprom
+ */
+typedef struct
+{
+    uint32_t frequency; // Hz
+    uint16_t duration;  // 0.1 s
+    uint16_t voltage;   // mV
+} SequencePlayer_Step_t;
+
+typedef struct
+{
+    uint8_t  step;          // currently running step, counted from 0
+    uint8_t  stepsCount;    // number of steps in the program
+    uint32_t remainingTime; // time to the end of the program, 0.1 s
+    uint8_t  lateSteps;     // steps which were switched late, as the next step was not prepared in time
+    bool     running;
+    bool     finished; // the last step has run to its end, false if the program was stopped
+} SequencePlayer_Progress_t;
+
+//===================================================================================================================//
+// Public variables                                                                                                  //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+bool SequencePlayer_Start(const SequencePlayer_Step_t *pSteps, uint8_t stepsCount, SequencePlayer_Memory_e memory);
+
+void SequencePlayer_Stop();
+
+bool SequencePlayer_IsRunning();
+
+void SequencePlayer_GetProgress(SequencePlayer_Progress_t *pProgress);
+
+void SequencePlayer_Perform();
+
+void SequencePlayer_PerformTick();
+
+#endif // SEQUENCE_PLAYER_H_
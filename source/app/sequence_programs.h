@@ -0,0 +1,42 @@
+/**
+ * @file sequence_programs.h
+ * @addtogroup Level_x_App
+ *
+ * @brief Programs for sequence player stored in flash
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+#ifndef SEQUENCE_PROGRAMS_H_
+#define SEQUENCE_PROGRAMS_H_
+
+// File specific includes
+#include "global_defines.h"
+#include "sequence_player.h"
+
+// Target specific includes
+#include <avr/pgmspace.h>
+
+//===================================================================================================================//
+// Public macro defines                                                                                              //
+//===================================================================================================================//
+
+#define SEQUENCE_PROGRAM_DEFAULT_STEPS (sizeof(sequenceProgram_Default) / sizeof(sequenceProgram_Default[0]))
+
+//===================================================================================================================//
+// Public variables                                                                                                  //
+//===================================================================================================================//
+
+// clang-format off
+static const SequencePlayer_Step_t sequenceProgram_Default[] PROGMEM = {
+//  frequency [Hz]  duration [0.1 s]    voltage [mV]
+    {1000,          600,                10000},
+    {10000,         600,                15000},
+    {50000,         1200,               20000},
+    {100000,        600,                15000},
+    {1000,          300,                10000},
+};
+// clang-format on
+
+#endif // SEQUENCE_PROGRAMS_H_
@@ -19,6 +19,11 @@
 #define UART_PRINTF_BUFFER_SIZE          96
 #define LOG_SHOW_FUNCTION_LINES          1
 
+// Clock calibration related
+#define CLOCK_CALIBRATION_BITS           64 // low bits of 0x55 characters measured for one OSCCAL value
+#define CLOCK_CALIBRATION_TIMEOUT        61 // timer 1 overflows (~8 ms) without an edge, the host is not sending
+#define CLOCK_CALIBRATION_WINDOW         32 // OSCCAL steps searched around the current value, power of 2
+
 // Adc related
 // Values referred to proper measuring
 #define ADC_VINTERNAL                    1300  // mV
@@ -40,18 +45,57 @@
 
 #define DCDC_MAX_OUTPUT_VOLTAGE          20000 // mV
 #define DCDC_MIN_OUTPUT_VOLTAGE          5000  // mV
+#define DCDC_VOLTAGE_STEP                5000  // mV, one press of a button
+#define DCDC_VOLTAGE_FINE_STEP           500   // mV, one repeat of a held button
 
 // Display Driver related
-#define DISPLAY_BLINKING_PERIOD          128
+#define DISPLAY_BLINK_PERIOD             524  // ms
+#define DISPLAY_BLINK_DUTY               50   // % of the period the display is on
+#define DISPLAY_DIM_TIMEOUT              4883 // system ticks (~10 s) without a button press before dimming
+#define DISPLAY_DIM_BRIGHTNESS           1    // 1 to DISPLAY_DRIVER_BRIGHTNESS_MAX
+#define DISPLAY_MESSAGE_MAX_LENGTH       16   // characters, dots are merged into the previous character
+#define DISPLAY_MESSAGE_QUEUE_SIZE       3
+#define DISPLAY_SCROLL_TICKS             146  // system ticks (~300 ms) of one scroll step
+#define DISPLAY_MESSAGE_HOLD_STEPS       3    // scroll steps the beginning and the end of a message are held
+
+// Scheduler related, periods in system ticks (~2 ms)
+#define SCHEDULER_MAX_TASKS              8
+#define MAIN_TASK_SEQUENCE_PERIOD        1
+#define MAIN_TASK_DISPLAY_PERIOD         1   // scrolling is counted in calls, see DISPLAY_SCROLL_TICKS
+#define MAIN_TASK_CONTROL_INPUT_PERIOD   10  // ~20 ms
+#define MAIN_TASK_STATE_MACHINE_PERIOD   5   // ~10 ms, the state timers count in these steps
+#define MAIN_TASK_MONITOR_PERIOD         244 // ~500 ms
 
 // Gpio related
-#define GPIO_DEBOUNCE_TIME               4
+#define GPIO_DEBOUNCE_TIME               4    // equal samples (system ticks), fixed by the 2 bit vertical counter
+#define GPIO_LONG_PRESS_TIME             293  // system ticks (~600 ms) of holding before a long press
+#define GPIO_REPEAT_PERIOD               146  // system ticks (~300 ms) of the first repeat after the long press
+#define GPIO_REPEAT_PERIOD_MIN           24   // system ticks (~50 ms), the fastest repeat
+#define GPIO_REPEAT_ACCELERATION         3    // each repeat period is shorter by 1/2^n of the previous one
+#define GPIO_DOUBLE_CLICK_TIME           146  // system ticks (~300 ms) from a short press release to the second press
+#define GPIO_EVENT_QUEUE_SIZE            8    // button events waiting for the main loop, power of 2
 
 // Output driver related
 #define OUTPUT_DRIVER_MIN_FREQUENCY      1   // kHz
 #define OUTPUT_DRIVER_MAX_FREQUENCY      100 // kHz
+#define OUTPUT_DRIVER_TABLE_MAX_ERROR    20  // 0.1 %, checked when the table is generated
+// Compare match interrupt of timer 2 waits for the longest other interrupt or atomic section, the system tick runs
+// with interrupts enabled. Estimated worst cases, the ADC interrupt is the longest one.
+#define OUTPUT_DRIVER_ISR_LATENCY_CYCLES 300 // cpu cycles
+#define OUTPUT_DRIVER_ISR_OCR_CYCLES     100 // cpu cycles from the compare match interrupt entry to the OCR write
+#define OUTPUT_DRIVER_DITHER_MIN_CYCLES  (OUTPUT_DRIVER_ISR_LATENCY_CYCLES + OUTPUT_DRIVER_ISR_OCR_CYCLES)
+#define OUTPUT_DRIVER_PULSE_MIN_CYCLES   (2 * OUTPUT_DRIVER_DITHER_MIN_CYCLES) // a missed edge would break the count
+
+#define OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY 1      // Hz
+#define OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY 500000 // Hz
+#define OUTPUT_DRIVER_SWEEP_MAX_STEPS     32
+#define OUTPUT_DRIVER_SWEEP_UPDATE_TICKS  5    // system ticks (~10 ms) between sweep updates
+#define OUTPUT_DRIVER_GATE_MIN_FREQUENCY  1    // 0.1 Hz
+#define OUTPUT_DRIVER_GATE_MAX_FREQUENCY  1000 // 0.1 Hz
 
-#define OUTPUT_DRIVER_CONTROL_IN_SAMPLES 8
+#define OUTPUT_DRIVER_CONTROL_IN_SAMPLES    8
+#define OUTPUT_DRIVER_CONTROL_IN_HYSTERESIS 4 // adc counts, about half of one step
+#define OUTPUT_DRIVER_BATTERY_MAX_ERROR     2 // adc counts, checked when the table is generated
 
 // Battery check related
 #define BATTERY_LOW_THRESHOLD            3300 // mV
@@ -49,6 +49,7 @@ typedef struct dcdc_driver
     uint16_t                setVoltage;
     uint16_t                actualVoltage;
     uint16_t                actualRawVoltage;
+    bool                    enabled;
     DcdcDriver_Averaging_t  averaging;
     DcdcDriver_OutControl_t output;
 } Dcdc_Driver_t;
@@ -186,9 +187,16 @@ void DcdcDriver_Enable(bool on)
     }
     else
     {
-        TimerHAL_StopTimer(eTIMER_1);
+        // disconnect first, a stopped timer would hold the output level
         TIMER_HAL_DISABLE_OCR1();
+        TimerHAL_StopTimer(eTIMER_1);
     }
+    hDcdc.enabled = on;
+}
+
+bool DcdcDriver_IsEnabled()
+{
+    return hDcdc.enabled;
 }
 
 void DcdcDriver_SetVoltage(uint16_t voltageLevel)
@@ -231,7 +239,14 @@ void DcdcDriver_Perform()
     }
     // LOG_WARN("Rvoltage is: %d", hDcdc.actualVoltage);
 
-    hDcdc.output.raw = DcdcDriver_privRegulateOutput(hDcdc.setVoltage, hDcdc.actualVoltage);
+    uint16_t setVoltage;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Set voltage can be changed from the system tick by the sequence player
+        setVoltage = hDcdc.setVoltage;
+    }
+
+    hDcdc.output.raw = DcdcDriver_privRegulateOutput(setVoltage, hDcdc.actualVoltage);
     DcdcDriver_privConvertOutputToSequence(hDcdc.output.raw);
 
     DcdcDriver_privPerformOutSequence();
@@ -38,6 +38,8 @@ bool DcdcDriver_Init();
 
 void DcdcDriver_Enable(bool on);
 
+bool DcdcDriver_IsEnabled();
+
 void DcdcDriver_SetVoltage(uint16_t voltageLevel);
 
 uint16_t DcdcDriver_GetVoltage();
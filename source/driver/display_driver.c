@@ -21,6 +21,8 @@
 
 // Target specific includes
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 
 //===================================================================================================================//
 // Private macro defines                                                                                             //
@@ -29,23 +31,130 @@
 #define DISPLAY_SPECIAL_L_INDEX 16
 #define DISPLAY_SPECIAL_o_INDEX 17
 #define DISPLAY_SPECIAL_r_INDEX 18
+
+// Segment map is placed in flash, use only this macro to read it
+#define DISPLAY_GET_SEGMENTS(digit) pgm_read_byte(&DisplayDriver_7SegmentMap[(digit)])
+
+#define DISPLAY_DIGITS              DISPLAY_DIGIT_COUNT
+#define DISPLAY_SEGMENTS            8
+
+#if (DISPLAY_DIGITS < 1) || (DISPLAY_DIGITS > 4)
+    #error "Display driver supports 1 to 4 digits"
+#endif
+
+// Port index in the port image
+#define DISPLAY_PORT_B              GPIO_PORT_ID_B
+#define DISPLAY_PORT_C              GPIO_PORT_ID_C
+#define DISPLAY_PORT_D              GPIO_PORT_ID_D
+#define DISPLAY_PORTS               3
+
+// Port image of one pin
+#define DISPLAY_PIN_IMAGE(...)                                                                                         \
+    {PIN_MASK_ON_PORT(B, __VA_ARGS__), PIN_MASK_ON_PORT(C, __VA_ARGS__), PIN_MASK_ON_PORT(D, __VA_ARGS__)}
+
+// Pins of the segments (active low) and digits (active high) on each port, computed from pinConfig.h
+#define DISPLAY_SEGMENT_MASK(port)  GPIO_GROUP_SEGMENTS(port)
+
+#if (DISPLAY_DIGITS > 3)
+    #define DISPLAY_DIGIT_3_MASK(port) PIN_MASK_ON_PORT(port, DISPLAY_DIGIT_3)
+#else
+    #define DISPLAY_DIGIT_3_MASK(port) 0
+#endif
+#if (DISPLAY_DIGITS > 2)
+    #define DISPLAY_DIGIT_2_MASK(port) PIN_MASK_ON_PORT(port, DISPLAY_DIGIT_2)
+#else
+    #define DISPLAY_DIGIT_2_MASK(port) 0
+#endif
+#if (DISPLAY_DIGITS > 1)
+    #define DISPLAY_DIGIT_1_MASK(port) PIN_MASK_ON_PORT(port, DISPLAY_DIGIT_1)
+#else
+    #define DISPLAY_DIGIT_1_MASK(port) 0
+#endif
+#define DISPLAY_DIGIT_MASK(port)                                                                                       \
+    (PIN_MASK_ON_PORT(port, DISPLAY_DIGIT_0) | DISPLAY_DIGIT_1_MASK(port) | DISPLAY_DIGIT_2_MASK(port) |               \
+     DISPLAY_DIGIT_3_MASK(port))
+
+#define DISPLAY_PORTB_MASK          (DISPLAY_SEGMENT_MASK(B) | DISPLAY_DIGIT_MASK(B))
+#define DISPLAY_PORTC_MASK          (DISPLAY_SEGMENT_MASK(C) | DISPLAY_DIGIT_MASK(C))
+#define DISPLAY_PORTD_MASK          (DISPLAY_SEGMENT_MASK(D) | DISPLAY_DIGIT_MASK(D))
+
+#define DISPLAY_GET_BRIGHTNESS_MASK(brightness) pgm_read_byte(&DisplayDriver_BrightnessMasks[(brightness)])
+
+// Font covers printable ASCII, other characters are blank
+#define DISPLAY_FONT_FIRST          ' '
+#define DISPLAY_GET_FONT(c)                                                                                            \
+    (((uint8_t)((c) - DISPLAY_FONT_FIRST) < sizeof(DisplayDriver_Font)) ?                                              \
+         pgm_read_byte(&DisplayDriver_Font[(uint8_t)((c) - DISPLAY_FONT_FIRST)]) :                                     \
+         0)
+#define DISPLAY_SEGMENT_DP          0x80
+#define DISPLAY_SEGMENT_MINUS       0x40
+
+// Decimal digits of uint16_t
+#define DISPLAY_BCD_DIGITS          5
+
+#if (DISPLAY_DIM_BRIGHTNESS < 1) || (DISPLAY_DIM_BRIGHTNESS > DISPLAY_DRIVER_BRIGHTNESS_MAX)
+    #error "DISPLAY_DIM_BRIGHTNESS is out of range"
+#endif
 //===================================================================================================================//
 // Private definitions                                                                                               //
 //===================================================================================================================//
 
+/**
+ * @brief Port image of one digit, segment bits are already inverted, the digit pin is set
+ */
+typedef struct
+{
+    uint8_t port[DISPLAY_PORTS];
+} DisplayDriver_Frame_t;
+
 typedef struct
 {
+    uint8_t                  segments[DISPLAY_MESSAGE_MAX_LENGTH];
+    uint8_t                  length;
+    DisplayDriver_Priority_e priority;
+} DisplayDriver_Message_t;
 
-    DisplayDriver_Mode_e activeMode;
-    uint8_t              activeDigits[2];
-    bool                 powered;
+/**
+ * @brief Messages are kept in fixed slots, only the slot indexes are reordered by priority
+ */
+typedef struct
+{
+    DisplayDriver_Message_t slots[DISPLAY_MESSAGE_QUEUE_SIZE];
+    uint8_t                 order[DISPLAY_MESSAGE_QUEUE_SIZE]; // slot indexes, the first one is shown
+    volatile uint8_t        count;
+    uint8_t                 step;      // scroll step of the shown message
+    uint8_t                 ticksLeft; // system ticks to the next scroll step
+} DisplayDriver_Messages_t;
+
+typedef struct
+{
+    uint32_t      period; // us
+    uint32_t      onTime; // us
+    uint32_t      phase;  // us from the start of the blink period
+    uint8_t       mask;   // digits which blink, bit 0 is the left digit
+    bool          on;
+    volatile bool changed; // phase has changed since the last check
+} DisplayDriver_Blink_t;
+
+typedef struct
+{
+
+    DisplayDriver_Mode_e           activeMode;
+    volatile DisplayDriver_Frame_t frames[2][DISPLAY_DIGITS]; // double buffer, rendered outside of the interrupt
+    volatile uint8_t               front;                     // buffer shown by the multiplexing
+    DisplayDriver_Blink_t          blink;
+    uint8_t                        brightness;     // level set by the application
+    volatile uint8_t               brightnessMask; // lit sub-slots of the digit, see DisplayDriver_BrightnessMasks
+    volatile uint16_t              idleTicks;      // system ticks to dimming, 0 when dimmed
+    uint8_t                        background[DISPLAY_DIGITS]; // segments set by SetNumber/SetSpecial
+    DisplayDriver_Messages_t       messages;
 } DisplayDriver_t;
 
 //===================================================================================================================//
 // Private variables                                                                                                 //
 //===================================================================================================================//
 
-const uint8_t DisplayDriver_7SegmentMap[19] = {
+const uint8_t DisplayDriver_7SegmentMap[19] PROGMEM = {
     0b00111111, // 0
     0b00000110, // 1
     0b01011011, // 2
@@ -67,81 +176,296 @@ const uint8_t DisplayDriver_7SegmentMap[19] = {
     0b01010000  // r
 };
 
+// Subtracted in the binary to BCD conversion, the last digit is the remainder
+const uint16_t DisplayDriver_PowersOf10[DISPLAY_BCD_DIGITS - 1] PROGMEM = {10000, 1000, 100, 10};
+
+// Segments of printable ASCII characters, bit 0 is segment a, bit 6 is segment g
+// clang-format off
+const uint8_t DisplayDriver_Font[96] PROGMEM = {
+    0x00, 0x86, 0x22, 0x00, 0x6D, 0x00, 0x00, 0x02, //   ! " # $ % & '
+    0x39, 0x0F, 0x00, 0x00, 0x80, 0x40, 0x80, 0x52, // ( ) * + , - . /
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, // 0 1 2 3 4 5 6 7
+    0x7F, 0x6F, 0x00, 0x00, 0x00, 0x48, 0x00, 0x53, // 8 9 : ; < = > ?
+    0x5F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71, 0x3D, // @ A B C D E F G
+    0x76, 0x30, 0x1E, 0x75, 0x38, 0x37, 0x54, 0x3F, // H I J K L M N O
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x3E, 0x2A, // P Q R S T U V W
+    0x76, 0x6E, 0x5B, 0x39, 0x64, 0x0F, 0x23, 0x08, // X Y Z [ \ ] ^ _
+    0x20, 0x5F, 0x7C, 0x58, 0x5E, 0x7B, 0x71, 0x6F, // ` a b c d e f g
+    0x74, 0x04, 0x0E, 0x75, 0x30, 0x54, 0x54, 0x5C, // h i j k l m n o
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x1C, 0x1C, 0x2A, // p q r s t u v w
+    0x76, 0x6E, 0x5B, 0x39, 0x30, 0x0F, 0x01, 0x00  // x y z { | } ~
+};
+// clang-format on
+
+// Port images of the segment pins, bit 0 of the segments is segment a
+const uint8_t DisplayDriver_SegmentPins[DISPLAY_SEGMENTS][DISPLAY_PORTS] PROGMEM = {
+    DISPLAY_PIN_IMAGE(SEG_A), DISPLAY_PIN_IMAGE(SEG_B), DISPLAY_PIN_IMAGE(SEG_C), DISPLAY_PIN_IMAGE(SEG_D),
+    DISPLAY_PIN_IMAGE(SEG_E), DISPLAY_PIN_IMAGE(SEG_F), DISPLAY_PIN_IMAGE(SEG_G), DISPLAY_PIN_IMAGE(SEG_DP)};
+
+// Port images of the digit pins from the left
+const uint8_t DisplayDriver_DigitPins[DISPLAY_DIGITS][DISPLAY_PORTS] PROGMEM = {
+    DISPLAY_PIN_IMAGE(DISPLAY_DIGIT_0),
+#if (DISPLAY_DIGITS > 1)
+    DISPLAY_PIN_IMAGE(DISPLAY_DIGIT_1),
+#endif
+#if (DISPLAY_DIGITS > 2)
+    DISPLAY_PIN_IMAGE(DISPLAY_DIGIT_2),
+#endif
+#if (DISPLAY_DIGITS > 3)
+    DISPLAY_PIN_IMAGE(DISPLAY_DIGIT_3),
+#endif
+};
+
+// Lit sub-slots out of DISPLAY_DRIVER_BRIGHTNESS_MAX for each brightness, spread to keep the flicker frequency high
+const uint8_t DisplayDriver_BrightnessMasks[DISPLAY_DRIVER_BRIGHTNESS_MAX + 1] PROGMEM = {
+    0b0000, // off
+    0b0001,
+    0b0101,
+    0b0111,
+    0b1111  // full
+};
+
 DisplayDriver_t display;
 //===================================================================================================================//
 // Private functions                                                                                                 //
 //===================================================================================================================//
 
-void DisplayDriver_privSetGpioDigit(uint8_t digit)
+/**
+ * @brief Writes the port image of the digit, only the display pins are changed.
+ *
+ * Ports without display pins are not touched at all, so the number of digits and the wiring cost no extra cycles.
+ *
+ * @param pFrame port image of the digit
+ * @param blank mask of the digit pins to be cleared, 0xFF if the digit is not lit
+ */
+static inline void DisplayDriver_privSetGpioDigit(const volatile DisplayDriver_Frame_t *pFrame, uint8_t blank)
+{
+#if (DISPLAY_PORTB_MASK != 0)
+    PORTB = (PORTB & ~DISPLAY_PORTB_MASK) | (pFrame->port[DISPLAY_PORT_B] & ~(DISPLAY_DIGIT_MASK(B) & blank));
+#endif
+#if (DISPLAY_PORTC_MASK != 0)
+    PORTC = (PORTC & ~DISPLAY_PORTC_MASK) | (pFrame->port[DISPLAY_PORT_C] & ~(DISPLAY_DIGIT_MASK(C) & blank));
+#endif
+#if (DISPLAY_PORTD_MASK != 0)
+    PORTD = (PORTD & ~DISPLAY_PORTD_MASK) | (pFrame->port[DISPLAY_PORT_D] & ~(DISPLAY_DIGIT_MASK(D) & blank));
+#endif
+}
+
+/**
+ * @brief Renders segments of all digits into the back buffer and shows it.
+ *
+ * The buffers are swapped by a single byte write, so the multiplexing never shows a half written frame. Rendering
+ * takes hundreds of cycles, so it is never done with interrupts disabled. Call it only from the main loop.
+ *
+ * @param pSegments segments of the digits from the left, bit 0 is segment a, bit 7 is dp
+ */
+static void DisplayDriver_privRender(const uint8_t *pSegments)
+{
+    uint8_t back = display.front ^ 1;
+
+    for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+    {
+        uint8_t segments = pSegments[i];
+
+        for(uint8_t port = 0; port < DISPLAY_PORTS; port++)
+        {
+            uint8_t image = pgm_read_byte(&DisplayDriver_DigitPins[i][port]);
+
+            // segments are active low, the pins of unlit segments are set
+            for(uint8_t segment = 0; segment < DISPLAY_SEGMENTS; segment++)
+            {
+                if(!(segments & (1 << segment)))
+                {
+                    image |= pgm_read_byte(&DisplayDriver_SegmentPins[segment][port]);
+                }
+            }
+            display.frames[back][i].port[port] = image;
+        }
+    }
+    display.front = back;
+}
+
+/**
+ * @brief Sets segments shown when no message is shown.
+ */
+static void DisplayDriver_privSetBackground(const uint8_t *pSegments)
+{
+    for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+    {
+        display.background[i] = pSegments[i];
+    }
+    // messages are changed only from the main loop, see DisplayDriver_PerformMessage
+    if(display.messages.count == 0)
+    {
+        DisplayDriver_privRender(display.background);
+    }
+}
+
+/**
+ * @brief Renders digits given by their index in the segment map.
+ *
+ * The digits are kept as the background, they are shown when no message is shown.
+ */
+static void DisplayDriver_privRenderDigits(uint8_t left, uint8_t right)
+{
+    uint8_t segments[DISPLAY_DIGITS] = {DISPLAY_GET_SEGMENTS(left)};
+
+#if (DISPLAY_DIGITS > 1)
+    segments[1] = DISPLAY_GET_SEGMENTS(right);
+#else
+    (void)right; // single digit shows only the left one
+#endif
+
+    DisplayDriver_privSetBackground(segments);
+}
+
+/**
+ * @brief Converts binary value to decimal digits without division.
+ *
+ * Each power of ten is subtracted while possible, so there are at most 9 subtractions per digit.
+ *
+ * @param value value to be converted
+ * @param pDigits DISPLAY_BCD_DIGITS digits, the most significant first
+ */
+static void DisplayDriver_privToBcd(uint16_t value, uint8_t *pDigits)
 {
-    PORTC = (PORTC & 0xC3) | ~((DisplayDriver_7SegmentMap[digit] & 0x0F) << 2);
-    PORTD = (PORTD & 0x0F) | ~((DisplayDriver_7SegmentMap[digit] & 0xF0));
+    for(uint8_t i = 0; i < (DISPLAY_BCD_DIGITS - 1); i++)
+    {
+        uint16_t power = pgm_read_word(&DisplayDriver_PowersOf10[i]);
+        uint8_t  digit = 0;
+
+        while(value >= power)
+        {
+            value -= power;
+            digit++;
+        }
+        pDigits[i] = digit;
+    }
+    pDigits[DISPLAY_BCD_DIGITS - 1] = (uint8_t)value;
 }
 
-bool DisplayDriver_privToggleBlinking()
+/**
+ * @brief Converts text into segments through the font, a dot is merged into the previous character.
+ *
+ * @param pText zero terminated text
+ * @param inFlash true if the text is placed in flash
+ * @param pSegments segments of the characters, up to DISPLAY_MESSAGE_MAX_LENGTH
+ * @return number of characters
+ */
+static uint8_t DisplayDriver_privRenderText(const char *pText, bool inFlash, uint8_t *pSegments)
 {
-    static uint16_t timer;
-    static bool blink;
+    uint8_t length = 0;
+    char    c;
 
-    if((timer >= DISPLAY_BLINKING_PERIOD))
+    while((c = inFlash ? (char)pgm_read_byte(pText) : *pText) != '\0')
     {
-        blink ^= 1;
-        timer = 0;
+        pText++;
+        if((c == '.') && (length != 0) && !(pSegments[length - 1] & DISPLAY_SEGMENT_DP))
+        {
+            pSegments[length - 1] |= DISPLAY_SEGMENT_DP;
+            continue;
+        }
+        if(length >= DISPLAY_MESSAGE_MAX_LENGTH)
+        {
+            break;
+        }
+        pSegments[length++] = DISPLAY_GET_FONT(c);
     }
-    timer++;
-    return blink;
+
+    return length;
 }
 
-bool DisplayDriver_privGetPowerMode()
+/**
+ * @brief Returns number of scroll positions of the message, 1 if the message fits the display.
+ */
+static inline uint8_t DisplayDriver_privGetMessagePositions(const DisplayDriver_Message_t *pMessage)
+{
+    return (pMessage->length > DISPLAY_DIGITS) ? (pMessage->length - DISPLAY_DIGITS + 1) : 1;
+}
+
+/**
+ * @brief Advances the blink phase by one system tick.
+ *
+ * Timing is kept in us like the output gate, so the blink period does not depend on the system tick rate.
+ */
+static inline void DisplayDriver_privPerformBlink()
+{
+    uint32_t phase = display.blink.phase + TIMER_HAL_SYSTICK_PERIOD_US;
+    bool     on    = display.blink.on;
+
+    if(phase >= display.blink.period)
+    {
+        phase -= display.blink.period;
+        on = true;
+    }
+    else if(phase >= display.blink.onTime)
+    {
+        on = false;
+    }
+    display.blink.phase = phase;
+
+    if(on != display.blink.on)
+    {
+        display.blink.on      = on;
+        display.blink.changed = true;
+    }
+}
+
+/**
+ * @brief Checks if the digit is lit in the current mode and blink phase.
+ *
+ * @param digit index of the digit, 0 is the left one
+ */
+static inline bool DisplayDriver_privIsDigitLit(uint8_t digit)
 {
     switch(display.activeMode)
     {
+    case eDISPLAY_MODE_BLINKING:
+        return display.blink.on || !(display.blink.mask & (1 << digit));
+    case eDISPLAY_MODE_ON:
+        return true;
     case eDISPLAY_MODE_OFF:
-        display.powered = false;
-        return 0;
-        case eDISPLAY_MODE_BLINKING:
-        display.powered = DisplayDriver_privToggleBlinking();
-        return display.powered;
-        case eDISPLAY_MODE_ON:
-        display.powered = true;
-        return 1;
+    default:
+        return false;
     }
-
-    return 0;
 }
 
 //===================================================================================================================//
 // Public functions                                                                                                  //
 //===================================================================================================================//
 
+/**
+ * @brief Shows the next digit, call it on each system tick.
+ *
+ * Brightness is made by blanking sub-slots: each digit gets DISPLAY_DRIVER_BRIGHTNESS_MAX slots in a row of
+ * multiplexing and it is lit only in the slots given by the brightness mask. The display is dimmed to
+ * DISPLAY_DIM_BRIGHTNESS after DISPLAY_DIM_TIMEOUT ticks without DisplayDriver_WakeUp.
+ */
 void DisplayDriver_PerformMultiplex()
 {
-    static uint8_t activeSegment;
+    static uint8_t activeDigit;
+    static uint8_t subSlot;
 
-    // toggle digit
-    activeSegment ^= 1;
-
-    // set proper digit (cathode)
-    DisplayDriver_privSetGpioDigit(display.activeDigits[activeSegment]);
+    // next digit
+    if(++activeDigit >= DISPLAY_DIGITS)
+    {
+        activeDigit = 0;
+        subSlot     = (subSlot + 1) & (DISPLAY_DRIVER_BRIGHTNESS_MAX - 1);
+    }
 
-    // set proper source (anode)
-    if(DisplayDriver_privGetPowerMode())
+    if((display.idleTicks != 0) && (--display.idleTicks == 0))
     {
-        if(activeSegment) // right segment
-        {
-            GPIO_SEG_LEFT_DISABLE();
-            GPIO_SEG_RIGHT_ENABLE();
-        }
-        else // left segment
-        {
-            GPIO_SEG_RIGHT_DISABLE();
-            GPIO_SEG_LEFT_ENABLE();
-        }
+        display.brightnessMask = DISPLAY_GET_BRIGHTNESS_MASK(DISPLAY_DIM_BRIGHTNESS);
     }
-    else
+    DisplayDriver_privPerformBlink();
+
+    // segments (cathodes) and the digit (anode) are written together
+    bool lit = DisplayDriver_privIsDigitLit(activeDigit) && (display.brightnessMask & (1 << subSlot));
+
+    // the ports are shared with the output keys, which are switched off by the fast stop interrupt
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        GPIO_SEG_LEFT_DISABLE();
-        GPIO_SEG_RIGHT_DISABLE();
+        DisplayDriver_privSetGpioDigit(&display.frames[display.front][activeDigit], lit ? 0 : 0xFF);
     }
 }
 
@@ -149,19 +473,104 @@ void DisplayDriver_PerformMultiplex()
  * @brief This function checks if any of needed peripherals are enabled.
  * All the peripherals shall be initialized before display driver.
  *
+ * Empty frame buffer would light all segments, so "00" is rendered before the display is switched on.
  */
-void DisplayDriver_Init() {}
+void DisplayDriver_Init()
+{
+    DisplayDriver_privRenderDigits(0, 0);
+    DisplayDriver_SetBrightness(DISPLAY_DRIVER_BRIGHTNESS_MAX);
+    DisplayDriver_SetBlink(DISPLAY_BLINK_PERIOD, DISPLAY_BLINK_DUTY, DISPLAY_DRIVER_BLINK_ALL);
+}
 
+/**
+ * @brief Sets the display mode, blinking starts with the display on.
+ */
 void DisplayDriver_SetMode(DisplayDriver_Mode_e mode)
 {
-    display.activeMode = mode;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if((mode == eDISPLAY_MODE_BLINKING) && (display.activeMode != eDISPLAY_MODE_BLINKING))
+        {
+            display.blink.phase   = 0;
+            display.blink.on      = true;
+            display.blink.changed = false;
+        }
+        display.activeMode = mode;
+    }
 }
 
 void DisplayDriver_SetNumber(uint8_t number)
 {
-    // split the number into two digits
-    display.activeDigits[0] = number / 10;
-    display.activeDigits[1] = number % 10;
+    uint8_t digits[DISPLAY_BCD_DIGITS];
+    uint8_t segments[DISPLAY_DIGITS];
+
+    // split the number into digits, the lowest ones are shown
+    DisplayDriver_privToBcd(number, digits);
+    for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+    {
+        segments[i] = DISPLAY_GET_SEGMENTS(digits[(DISPLAY_BCD_DIGITS - DISPLAY_DIGITS) + i]);
+    }
+    DisplayDriver_privSetBackground(segments);
+}
+
+/**
+ * @brief Shows fixed point value with the decimal point placed automatically.
+ *
+ * The two most significant digits are shown and the rest is rounded, e.g. 4812 with 3 decimals is shown as 4.8 and
+ * 12345 with 3 decimals as 12. Values with more integer digits than the display are shown as "--".
+ *
+ * @param value fixed point value
+ * @param decimals number of decimal digits in the value, up to 4
+ */
+void DisplayDriver_SetFixed(uint16_t value, uint8_t decimals)
+{
+    uint8_t digits[DISPLAY_BCD_DIGITS];
+    uint8_t segments[DISPLAY_DIGITS];
+    uint8_t units = (DISPLAY_BCD_DIGITS - 1) - ((decimals < DISPLAY_BCD_DIGITS) ? decimals : (DISPLAY_BCD_DIGITS - 1));
+    uint8_t first = 0;
+
+    DisplayDriver_privToBcd(value, digits);
+
+    // the first shown digit is the most significant one, but the units are always shown
+    while((first < units) && (first < (DISPLAY_BCD_DIGITS - DISPLAY_DIGITS)) && (digits[first] == 0))
+    {
+        first++;
+    }
+    if(((first + DISPLAY_DIGITS) < DISPLAY_BCD_DIGITS) && (digits[first + DISPLAY_DIGITS] >= 5))
+    {
+        int8_t i = first + DISPLAY_DIGITS - 1;
+
+        // round up, carry can add a digit in front (9.96 -> 10)
+        while((i >= 0) && (++digits[i] == 10))
+        {
+            digits[i--] = 0;
+        }
+        if((first > 0) && (digits[first - 1] != 0))
+        {
+            first--;
+        }
+    }
+
+    if((first + DISPLAY_DIGITS) <= units)
+    {
+        // the units do not fit, overflow is shown on all digits
+        for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+        {
+            segments[i] = DISPLAY_SEGMENT_MINUS;
+        }
+    }
+    else
+    {
+        for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+        {
+            segments[i] = DISPLAY_GET_SEGMENTS(digits[first + i]);
+        }
+        if(first == units)
+        {
+            segments[0] |= DISPLAY_SEGMENT_DP;
+        }
+    }
+    DisplayDriver_privSetBackground(segments);
 }
 
 void DisplayDriver_SetSpecial(DisplayDriver_SpecialDigit_e digit)
@@ -169,23 +578,234 @@ void DisplayDriver_SetSpecial(DisplayDriver_SpecialDigit_e digit)
     switch(digit)
     {
     case eDISPLAY_DIGIT_ERROR:
-        display.activeDigits[0] = 0x0E;                    // E
-        display.activeDigits[1] = DISPLAY_SPECIAL_r_INDEX; // r
+        DisplayDriver_privRenderDigits(0x0E, DISPLAY_SPECIAL_r_INDEX); // Er
         break;
     case eDISPLAY_DIGIT_BATTERY:
-        display.activeDigits[0] = 0x0B; // B
-        display.activeDigits[1] = 0x0A; // A
+        DisplayDriver_privRenderDigits(0x0B, 0x0A); // bA
         break;
     case eDISPLAY_DIGIT_BATTERY_LOW:
-        display.activeDigits[0] = DISPLAY_SPECIAL_L_INDEX; // L
-        display.activeDigits[1] = DISPLAY_SPECIAL_o_INDEX; // o
+        DisplayDriver_privRenderDigits(DISPLAY_SPECIAL_L_INDEX, DISPLAY_SPECIAL_o_INDEX); // Lo
         break;
     default:
         break;
     }
 }
 
-bool DisplayDriver_IsPowered()
+/**
+ * @brief Sets blinking used in eDISPLAY_MODE_BLINKING, running blinking continues with the new settings.
+ *
+ * @param period blink period in ms
+ * @param duty part of the period the digits are on, in %
+ * @param mask digits which blink, bit 0 is the left digit, the other digits are on
+ */
+void DisplayDriver_SetBlink(uint16_t period, uint8_t duty, uint8_t mask)
+{
+    uint32_t periodUs = (uint32_t)period * 1000;
+
+    if(duty > 100)
+    {
+        duty = 100;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        display.blink.period = periodUs;
+        display.blink.onTime = (periodUs / 100) * duty;
+        display.blink.mask   = mask;
+        if(display.blink.phase >= periodUs)
+        {
+            display.blink.phase = 0;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the blink phase has changed since the last check.
+ *
+ * @param pOn new phase, true if the blinking digits are on
+ * @return true once after each change of the phase
+ */
+bool DisplayDriver_IsBlinkPhaseChanged(bool *pOn)
+{
+    bool changed;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        changed               = display.blink.changed;
+        *pOn                  = display.blink.on;
+        display.blink.changed = false;
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Shows a message, texts longer than the display are scrolled.
+ *
+ * Message with higher priority than the shown one interrupts it, the interrupted message is shown again from the
+ * beginning later. Otherwise the message is queued behind messages of the same or higher priority. If the queue is
+ * full, the message with the lowest priority is dropped. The text is converted here, it does not need to be kept.
+ *
+ * @param pText zero terminated text, see DisplayDriver_Font for the characters
+ * @param inFlash true if the text is placed in flash (PSTR)
+ * @param priority priority of the message
+ * @return false if the message was dropped
+ */
+bool DisplayDriver_ShowMessage(const char *pText, bool inFlash, DisplayDriver_Priority_e priority)
+{
+    DisplayDriver_Messages_t *pMessages = &display.messages;
+    DisplayDriver_Message_t  *pMessage  = NULL;
+    uint8_t                   count     = pMessages->count;
+    uint8_t                   index;
+
+    // full queue drops its last message, if it has lower priority than the new one
+    if((count == DISPLAY_MESSAGE_QUEUE_SIZE) && (pMessages->slots[pMessages->order[count - 1]].priority < priority))
+    {
+        pMessages->count = --count;
+    }
+    if(count < DISPLAY_MESSAGE_QUEUE_SIZE)
+    {
+        uint8_t used = 0;
+
+        for(uint8_t i = 0; i < count; i++)
+        {
+            used |= 1 << pMessages->order[i];
+        }
+        for(uint8_t slot = 0; slot < DISPLAY_MESSAGE_QUEUE_SIZE; slot++)
+        {
+            if(!(used & (1 << slot)))
+            {
+                pMessage = &pMessages->slots[slot];
+                break;
+            }
+        }
+    }
+
+    if(pMessage == NULL)
+    {
+        return false;
+    }
+
+    pMessage->length   = DisplayDriver_privRenderText(pText, inFlash, pMessage->segments);
+    pMessage->priority = priority;
+    if(pMessage->length == 0)
+    {
+        return false;
+    }
+
+    index = pMessages->count;
+    while((index > 0) && (pMessages->slots[pMessages->order[index - 1]].priority < priority))
+    {
+        pMessages->order[index] = pMessages->order[index - 1];
+        index--;
+    }
+    pMessages->order[index] = (uint8_t)(pMessage - pMessages->slots);
+    pMessages->count++;
+    if(index == 0)
+    {
+        // shown on the next system tick
+        pMessages->step      = 0;
+        pMessages->ticksLeft = 1;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Removes all messages, the background is shown.
+ */
+void DisplayDriver_ClearMessages()
+{
+    display.messages.count = 0;
+    DisplayDriver_privRender(display.background);
+}
+
+bool DisplayDriver_IsMessageActive()
 {
-    return display.powered;
+    return (display.messages.count != 0);
+}
+
+/**
+ * @brief Scrolls the shown message, call it from the main loop once per system tick (scheduler task).
+ *
+ * The message is rendered only once per scroll step. When it ends, the next queued message or the background is shown.
+ * The message queue is not guarded against interrupts, the display functions must not be called from an interrupt.
+ */
+void DisplayDriver_PerformMessage()
+{
+    DisplayDriver_Messages_t *pMessages = &display.messages;
+
+    if((pMessages->count == 0) || (--pMessages->ticksLeft != 0))
+    {
+        return;
+    }
+    pMessages->ticksLeft = DISPLAY_SCROLL_TICKS;
+
+    const DisplayDriver_Message_t *pMessage = &pMessages->slots[pMessages->order[0]];
+
+    // the first and the last position are held for DISPLAY_MESSAGE_HOLD_STEPS
+    if(pMessages->step >= (DisplayDriver_privGetMessagePositions(pMessage) + 2 * (DISPLAY_MESSAGE_HOLD_STEPS - 1)))
+    {
+        uint8_t count = pMessages->count - 1;
+
+        for(uint8_t i = 0; i < count; i++)
+        {
+            pMessages->order[i] = pMessages->order[i + 1];
+        }
+        pMessages->count = count;
+        pMessages->step  = 0;
+        if(count == 0)
+        {
+            DisplayDriver_privRender(display.background);
+            return;
+        }
+        pMessage = &pMessages->slots[pMessages->order[0]];
+    }
+
+    uint8_t step     = pMessages->step;
+    uint8_t last     = DisplayDriver_privGetMessagePositions(pMessage) - 1;
+    uint8_t position = (step < DISPLAY_MESSAGE_HOLD_STEPS) ? 0 : (step - (DISPLAY_MESSAGE_HOLD_STEPS - 1));
+    uint8_t segments[DISPLAY_DIGITS];
+
+    if(position > last)
+    {
+        position = last;
+    }
+    for(uint8_t i = 0; i < DISPLAY_DIGITS; i++)
+    {
+        segments[i] = ((position + i) < pMessage->length) ? pMessage->segments[position + i] : 0;
+    }
+    DisplayDriver_privRender(segments);
+    pMessages->step = step + 1;
+}
+
+/**
+ * @brief Sets brightness of the display, the display is woken up.
+ *
+ * @param brightness 1 to DISPLAY_DRIVER_BRIGHTNESS_MAX (full)
+ */
+void DisplayDriver_SetBrightness(uint8_t brightness)
+{
+    if(brightness < 1)
+    {
+        brightness = 1;
+    }
+    if(brightness > DISPLAY_DRIVER_BRIGHTNESS_MAX)
+    {
+        brightness = DISPLAY_DRIVER_BRIGHTNESS_MAX;
+    }
+    display.brightness = brightness;
+    DisplayDriver_WakeUp();
+}
+
+/**
+ * @brief Restores the brightness after dimming and restarts the inactivity timeout. Call it on user activity.
+ */
+void DisplayDriver_WakeUp()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        display.brightnessMask = DISPLAY_GET_BRIGHTNESS_MASK(display.brightness);
+        display.idleTicks      = DISPLAY_DIM_TIMEOUT;
+    }
 }
\ No newline at end of file
@@ -24,6 +24,11 @@
 // Public macro defines                                                                                              //
 //===================================================================================================================//
 
+#define DISPLAY_DRIVER_BRIGHTNESS_MAX 4
+
+// Blink mask of all digits, bit 0 is the left digit
+#define DISPLAY_DRIVER_BLINK_ALL      0xFF
+
 //===================================================================================================================//
 // Public definitions                                                                                                //
 //===================================================================================================================//
@@ -39,6 +44,16 @@ typedef enum {
     eDISPLAY_DIGIT_BATTERY_LOW,
     eDISPLAY_DIGIT_MAX_VALUES
 }DisplayDriver_SpecialDigit_e;
+
+/**
+ * @brief Priority of a message, higher priority interrupts the shown message, the rest is queued
+ */
+typedef enum
+{
+    eDISPLAY_PRIORITY_LOW,
+    eDISPLAY_PRIORITY_NORMAL,
+    eDISPLAY_PRIORITY_HIGH
+} DisplayDriver_Priority_e;
 //===================================================================================================================//
 // Public variables                                                                                                  //
 //===================================================================================================================//
@@ -55,9 +70,25 @@ void DisplayDriver_SetMode(DisplayDriver_Mode_e mode);
 
 void DisplayDriver_SetNumber(uint8_t number);
 
+void DisplayDriver_SetFixed(uint16_t value, uint8_t decimals);
+
 void DisplayDriver_SetSpecial(DisplayDriver_SpecialDigit_e digit);
 
-bool DisplayDriver_IsPowered();
+void DisplayDriver_SetBlink(uint16_t period, uint8_t duty, uint8_t mask);
+
+bool DisplayDriver_IsBlinkPhaseChanged(bool *pOn);
+
+void DisplayDriver_SetBrightness(uint8_t brightness);
+
+void DisplayDriver_WakeUp();
+
+bool DisplayDriver_ShowMessage(const char *pText, bool inFlash, DisplayDriver_Priority_e priority);
+
+void DisplayDriver_ClearMessages();
+
+bool DisplayDriver_IsMessageActive();
+
+void DisplayDriver_PerformMessage();
 
 
 #endif // DISPLAY_DRIVER_H_
\ No newline at end of file
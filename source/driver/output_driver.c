@@ -16,6 +16,7 @@
 #include "system_settings.h"
 
 #include "adc.h"
+#include "gpio.h"
 #include "logging.h"
 #include "timer_hal.h"
 
@@ -27,20 +28,152 @@
 // Private macro defines                                                                                             //
 //===================================================================================================================//
 
-#define SUPPLY_REFERENCE_VOLTAGE 5000 // mV
-
 #define CONTROL_INPUT_OFFSET     25
+
+// Half period of the output is calculated in 1/256 of timer tick
+#define PERIOD_FRACTION_BITS     8
+#define PERIOD_MAX               ((uint32_t)UINT16_MAX)
+#define TIMER_CLOCK_FRACTIONAL   ((uint32_t)F_CPU << PERIOD_FRACTION_BITS)
+
+// Longest timer period used when the half period is extended in software, two ticks are left for dithering
+#define SEGMENT_MAX_TICKS        254
+
+#if (F_CPU > (UINT32_MAX >> PERIOD_FRACTION_BITS))
+    #error "F_CPU is too high for the output period calculation"
+#endif
+// Lowest frequency which timer 2 can make without extending the period in software
+#define SWEEP_MIN_FREQUENCY      ((F_CPU / (2UL * 1024UL * 256UL)) + 1)
+
+#define SWEEP_UPDATE_PERIOD_US   (TIMER_HAL_SYSTICK_PERIOD_US * OUTPUT_DRIVER_SWEEP_UPDATE_TICKS)
+
+// Gate frequency is set in 0.1 Hz
+#define GATE_PERIOD_US_DIVIDEND  10000000UL
+
+#if (OUTPUT_DRIVER_GATE_MAX_FREQUENCY > (GATE_PERIOD_US_DIVIDEND / (2 * TIMER_HAL_SYSTICK_PERIOD_US)))
+    #error "OUTPUT_DRIVER_GATE_MAX_FREQUENCY is too high, the gate would be shorter than the system tick"
+#endif
+
+// Repeat interval of the pulse train is set in ms and counted in half periods of the carrier
+#define PULSE_INTERVAL_DIVIDER   500UL
+
+#if (OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY > (F_CPU / 4))
+    #error "OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY is too high, OCR would be 0"
+#endif
+
 //===================================================================================================================//
 // Private definitions                                                                                               //
 //===================================================================================================================//
 
+typedef enum
+{
+    eWAVE_SQUARE,   // 50 % duty, toggled on compare match or extended in software when segments > 1
+    eWAVE_PWM,      // high and low half have own length, switched by set/clear on compare match from the interrupt
+    eWAVE_FAST_PWM, // hardware fast PWM, the frequency is given by the prescaler only
+    eWAVE_LOW,      // constant level, reached on the next compare match
+    eWAVE_HIGH
+} OutputDriver_Wave_e;
+
+typedef struct
+{
+    uint8_t  baseOcr;      // ocr of the shorter segment
+    uint8_t  fraction;     // fractional part of the half period
+    uint8_t  accum;        // each overflow of the accumulator stretches the half period by one tick
+    uint16_t segments;     // timer periods in one half period of the output, 1 if not extended in software
+    uint16_t longSegments; // number of segments which are one tick longer
+    uint16_t segment;      // currently running segment
+    bool     level;        // output level in the current half period
+    uint8_t  prescaler;    // timer 2 prescaler
+    bool     useIsr;       // compare match interrupt is needed for dithering or extending
+    // Low half of eWAVE_PWM, the fields above describe the high half
+    uint8_t             lowOcr;
+    uint16_t            lowSegments;
+    uint16_t            lowLongSegments;
+    OutputDriver_Wave_e wave;
+} OutputDriver_Synth_t;
+
+typedef struct
+{
+    uint8_t ocr;
+    uint8_t fraction;
+    uint8_t prescaler : 3;
+    bool    dither    : 1;
+} OutputDriver_SweepStep_t;
+
+typedef enum
+{
+    eSWEEP_STATE_IDLE,
+    eSWEEP_STATE_RUNNING,
+    eSWEEP_STATE_HOLD,
+    eSWEEP_STATE_DONE
+} OutputDriver_SweepState_e;
+
+typedef struct
+{
+    OutputDriver_SweepStep_t  steps[OUTPUT_DRIVER_SWEEP_MAX_STEPS];
+    uint8_t                   stepsCount;
+    uint8_t                   step;
+    uint16_t                  updatesPerStep;
+    uint16_t                  extraUpdates; // remainder of updates, spread over the steps
+    uint16_t                  extraAccum;
+    uint16_t                  updatesLeft;
+    uint8_t                   ticksLeft;
+    bool                      repeat;
+    OutputDriver_SweepState_e state;
+} OutputDriver_Sweep_t;
+
+typedef struct
+{
+    uint32_t period; // us
+    uint32_t onTime; // us
+    uint32_t phase;  // us from the start of the gate period
+    bool     closed; // carrier is held low
+    bool     active;
+} OutputDriver_Gate_t;
+
+typedef enum
+{
+    ePULSE_STATE_IDLE,    // carrier runs continuously
+    ePULSE_STATE_RUNNING, // pulses are counted, OC2 toggles
+    ePULSE_STATE_GAP,     // OC2 is disconnected until the repeat interval elapses
+    ePULSE_STATE_DONE     // OC2 is disconnected after the last pulse
+} OutputDriver_PulseState_e;
+
+typedef struct
+{
+    uint32_t                  count;      // pulses in one train
+    uint32_t                  pulsesLeft; // pulses to the end of the running train
+    uint32_t                  gapEdges;   // compare matches between trains, 0 if the train is not repeated
+    uint32_t                  edgesLeft;  // compare matches to the end of the gap
+    bool                      high;       // output level after the last compare match
+    OutputDriver_PulseState_e state;
+} OutputDriver_Pulse_t;
+
+typedef struct
+{
+    uint16_t          samples[OUTPUT_DRIVER_CONTROL_IN_SAMPLES];
+    uint8_t           position;
+    volatile uint16_t sum;     // running sum of the samples, updated in the ADC interrupt
+    volatile bool     updated; // sum has changed since the last tracking
+    uint16_t          bandLow; // raw values in the band keep the current value (hysteresis included)
+    uint16_t          bandHigh;
+    bool              valid;
+    bool              changed;
+} OutputDriver_ControlInput_t;
+
 typedef struct
 {
-    uint16_t controlInputSamples[OUTPUT_DRIVER_CONTROL_IN_SAMPLES];
-    uint8_t  setFrequency;
-    uint16_t rawControlInput;
-    uint16_t controlInput;
-    bool     enabled;
+    OutputDriver_ControlInput_t   control;
+    uint8_t                       setFrequency;
+    uint32_t                      actualFrequency; // Hz
+    uint16_t                      rawControlInput;
+    uint16_t                      controlInput;
+    bool                          enabled;
+    volatile OutputDriver_Synth_t synth;
+    volatile OutputDriver_Synth_t pending; // settings waiting for the next compare match
+    volatile bool                 pendingValid;
+    volatile OutputDriver_Sweep_t sweep;
+    volatile OutputDriver_Gate_t  gate;
+    volatile OutputDriver_Pulse_t pulse;
 } OutputDriver_t;
 
 //===================================================================================================================//
@@ -62,146 +195,1478 @@ static void OutputDriver_privSetTimerPrescaler(uint8_t prescaler)
     }
 }
 
-static uint16_t OutputDriver_privGetControlInputMaxAdcValue()
+/**
+ * @brief Calculates output frequency for given timer settings
+ *
+ * @param prescaler prescaler value written into the timer
+ * @param period half period of the output in 1/256 of timer tick
+ * @return frequency in Hz
+ */
+static uint32_t OutputDriver_privCalculateFrequency(uint8_t prescaler, uint32_t period)
 {
-    uint16_t voltage = Adc_GetSupplyVoltage();
+    return (TIMER_CLOCK_FRACTIONAL >> OUTPUT_DRIVER_PRESCALER_SHIFT_GET(prescaler)) / (2 * period);
+}
 
-    int16_t error = SUPPLY_REFERENCE_VOLTAGE - voltage;
-    // Add 50 to better rounding to proper value (50 is half of 0.1 V resolution)
-    error                  = (error + 50) / 100;
-    int8_t correctionIndex = OUTPUT_DRIVER_BATTERY_OFFSET_REFERENCE_INDEX - error;
+/**
+ * @brief Multiplies a value by a Q16 ratio.
+ *
+ * The product is made of 16 bit partial products, so no 64 bit arithmetic is needed. The lowest partial product is
+ * truncated, the error is below 1 of the result.
+ *
+ * @param value multiplied value
+ * @param ratio ratio in Q16
+ * @return (value * ratio) >> 16, UINT32_MAX if it does not fit
+ */
+static uint32_t OutputDriver_privMulQ16(uint32_t value, uint32_t ratio)
+{
+    uint16_t valueHigh = (uint16_t)(value >> 16);
+    uint16_t valueLow  = (uint16_t)value;
+    uint16_t ratioHigh = (uint16_t)(ratio >> 16);
+    uint16_t ratioLow  = (uint16_t)ratio;
+    uint32_t high      = (uint32_t)valueHigh * ratioHigh;
+    uint32_t cross     = (uint32_t)valueHigh * ratioLow;
+    uint32_t result    = ((uint32_t)valueLow * ratioLow) >> 16;
+
+    if(high > UINT16_MAX)
+    {
+        return UINT32_MAX;
+    }
 
-    if(correctionIndex < 0)
-        correctionIndex = 0;
-    if(correctionIndex > OUTPUT_DRIVER_BATTERY_OFFSET_TABLE_SIZE)
-        correctionIndex = OUTPUT_DRIVER_BATTERY_OFFSET_TABLE_SIZE;
+    // unsigned sum is smaller than its part when it overflows
+    result += cross;
+    if(result < cross)
+    {
+        return UINT32_MAX;
+    }
+    cross = (uint32_t)valueLow * ratioHigh;
+    result += cross;
+    if(result < cross)
+    {
+        return UINT32_MAX;
+    }
+    high <<= 16;
+    result += high;
+    if(result < high)
+    {
+        return UINT32_MAX;
+    }
 
-    return outputDriver_BatteryOffsetTable[correctionIndex];
+    return result;
 }
 
-//===================================================================================================================//
-// Public functions                                                                                                  //
-//===================================================================================================================//
+/**
+ * @brief Raises a Q16 ratio of at least 1 to an integer power by repeated squaring.
+ *
+ * @param ratio ratio in Q16
+ * @param exponent power
+ * @return ratio^exponent in Q16, UINT32_MAX if it does not fit
+ */
+static uint32_t OutputDriver_privPowQ16(uint32_t ratio, uint8_t exponent)
+{
+    uint32_t result = 1UL << 16;
+
+    while(exponent != 0)
+    {
+        if((exponent & 1) != 0)
+        {
+            result = OutputDriver_privMulQ16(result, ratio);
+        }
+        exponent >>= 1;
+        if(exponent != 0)
+        {
+            ratio = OutputDriver_privMulQ16(ratio, ratio);
+        }
+    }
+
+    return result;
+}
 
 /**
- * @brief If possible, adds measurement to averaging process.
+ * @brief Finds the ratio of neighbouring steps of the logarithmic sweep.
  *
+ * The ratio is searched by bisection for the largest one with low * ratio^intervals <= high, so the rising steps
+ * never get above the high frequency. Frequencies are in Q8, so the ratio has a resolution of 1/65536 even for the
+ * lowest frequencies. The 32 halvings take a few ms, it is done only when the sweep is prepared.
  *
- * @param measurement Input value to be processed
+ * @param low lower frequency in Hz
+ * @param high higher frequency in Hz
+ * @param intervals number of steps minus one
+ * @return ratio in Q16, at least 1
  */
-void OutputDriver_PerformControlInput(uint16_t measurement)
+static uint32_t OutputDriver_privFindSweepRatio(uint32_t low, uint32_t high, uint8_t intervals)
 {
-    static uint8_t position = 0;
+    uint32_t lowQ8  = low << 8;
+    uint32_t highQ8 = high << 8;
+    uint32_t lower  = 1UL << 16;
+    uint32_t upper  = UINT32_MAX; // excluded, high / low is far below it
 
-    hOutput.controlInputSamples[position] = measurement - CONTROL_INPUT_OFFSET;
+    while((upper - lower) > 1)
+    {
+        uint32_t middle = lower + ((upper - lower) >> 1);
+
+        if(OutputDriver_privMulQ16(lowQ8, OutputDriver_privPowQ16(middle, intervals)) <= highQ8)
+        {
+            lower = middle;
+        }
+        else
+        {
+            upper = middle;
+        }
+    }
 
-    position = (position + 1) % OUTPUT_DRIVER_CONTROL_IN_SAMPLES;
+    return lower;
 }
 
 /**
- * @brief Initializes Output driver.
+ * @brief Checks if the output is driven by set/clear on compare match from the interrupt.
+ */
+static inline bool OutputDriver_privIsExtended()
+{
+    OutputDriver_Wave_e wave = hOutput.synth.wave;
+
+    return (wave == eWAVE_PWM) || ((wave == eWAVE_SQUARE) && (hOutput.synth.segments > 1));
+}
+
+/**
+ * @brief Returns number of segments of the half period with given output level.
+ */
+static inline uint16_t OutputDriver_privGetSegments(bool level)
+{
+    return (!level && (hOutput.synth.wave == eWAVE_PWM)) ? hOutput.synth.lowSegments : hOutput.synth.segments;
+}
+
+/**
+ * @brief Returns ocr of the first segment of the half period with given output level.
+ */
+static inline uint8_t OutputDriver_privGetFirstOcr(bool level)
+{
+    if(!level && (hOutput.synth.wave == eWAVE_PWM))
+    {
+        return hOutput.synth.lowOcr + ((hOutput.synth.lowLongSegments != 0) ? 1 : 0);
+    }
+    return hOutput.synth.baseOcr + ((hOutput.synth.longSegments != 0) ? 1 : 0);
+}
+
+/**
+ * @brief Connects OC2 to the output in the mode needed for current settings.
  *
- * Timer 1 must be initialized before this function call.
+ * Software extended period and PWM use set/clear on compare match (the interrupt decides when the output changes),
+ * otherwise the output is toggled on each compare match. Closed gate clears the output on the next compare match, so
+ * the last pulse is never cut short. Hardware PWM is disconnected instead, as it sets the output on each period.
+ */
+static void OutputDriver_privConnectOutput()
+{
+    OutputDriver_Wave_e wave = hOutput.synth.wave;
+
+    if((hOutput.pulse.state == ePULSE_STATE_GAP) || (hOutput.pulse.state == ePULSE_STATE_DONE))
+    {
+        TIMER_HAL_DISABLE_OCR2();
+    }
+    else if(hOutput.gate.closed || (wave == eWAVE_LOW))
+    {
+        if(wave == eWAVE_FAST_PWM)
+        {
+            TIMER_HAL_DISABLE_OCR2();
+        }
+        else
+        {
+            TIMER_HAL_SET_OCR2_ON_COMPARE(false);
+        }
+    }
+    else if(wave == eWAVE_HIGH)
+    {
+        TIMER_HAL_SET_OCR2_ON_COMPARE(true);
+    }
+    else if(wave == eWAVE_FAST_PWM)
+    {
+        TIMER_HAL_ENABLE_OCR2_PWM();
+    }
+    else if(OutputDriver_privIsExtended())
+    {
+        bool level = hOutput.synth.level;
+        bool last  = (hOutput.synth.segment == (uint16_t)(OutputDriver_privGetSegments(level) - 1));
+
+        TIMER_HAL_SET_OCR2_ON_COMPARE(last ? !level : level);
+    }
+    else
+    {
+        TIMER_HAL_ENABLE_OCR2();
+    }
+}
+
+/**
+ * @brief Checks if the pulses of the current settings can be counted in the compare match interrupt.
  *
+ * Only the square wave toggled by the hardware has one compare match per edge. The half period must be at least
+ * OUTPUT_DRIVER_PULSE_MIN_CYCLES, twice the worst case latency of the interrupt, as a missed edge is never recovered.
  */
-void OutputDriver_Init()
+static bool OutputDriver_privIsPulseCapable()
 {
-    TimerHAL_StartTimer(eTIMER_2);
+    if((hOutput.synth.wave != eWAVE_SQUARE) || (hOutput.synth.segments != 1) || (hOutput.synth.prescaler == 0))
+    {
+        return false;
+    }
+
+    uint8_t  shift  = OUTPUT_DRIVER_PRESCALER_SHIFT_GET(hOutput.synth.prescaler);
+    uint32_t cycles = ((uint32_t)hOutput.synth.baseOcr + 1) << shift;
+
+    return (cycles >= OUTPUT_DRIVER_PULSE_MIN_CYCLES);
 }
 
 /**
- * @brief Enables output
+ * @brief Starts the pulse train on the next compare match. Called with interrupts disabled.
  *
+ * OC2 is forced low through clear on compare match first, so the first edge toggled by the timer is always rising.
  */
-void OutputDriver_Enable()
+static void OutputDriver_privStartPulseTrain()
 {
+    TIMER_HAL_SET_OCR2_ON_COMPARE(false);
+    TIMER_HAL_FORCE_OCR2();
     TIMER_HAL_ENABLE_OCR2();
-    hOutput.enabled = true;
+    hOutput.pulse.high       = false;
+    hOutput.pulse.pulsesLeft = hOutput.pulse.count;
+    hOutput.pulse.state      = ePULSE_STATE_RUNNING;
 }
 
 /**
- * @brief Disables output
+ * @brief Counts edges of the pulse train, called from the compare match interrupt right after each edge.
  *
+ * OC2 is disconnected right after the last falling edge, the pin is then held low by its port register. The interrupt
+ * comes long before the next compare match (see OutputDriver_privIsPulseCapable), so there is never a partial pulse.
  */
-void OutputDriver_Disable()
+static void OutputDriver_privPerformPulse()
 {
-    TIMER_HAL_DISABLE_OCR2();
-    hOutput.enabled = false;
+    if(hOutput.pulse.state == ePULSE_STATE_RUNNING)
+    {
+        bool high = !hOutput.pulse.high;
+
+        hOutput.pulse.high = high;
+        if(!high && (--hOutput.pulse.pulsesLeft == 0))
+        {
+            TIMER_HAL_DISABLE_OCR2();
+            hOutput.pulse.edgesLeft = hOutput.pulse.gapEdges;
+            hOutput.pulse.state     = (hOutput.pulse.gapEdges != 0) ? ePULSE_STATE_GAP : ePULSE_STATE_DONE;
+        }
+    }
+    else if(hOutput.pulse.state == ePULSE_STATE_GAP)
+    {
+        if(--hOutput.pulse.edgesLeft == 0)
+        {
+            OutputDriver_privStartPulseTrain();
+        }
+    }
 }
 
 /**
- * @brief Set the frequency based on the input parameter.
- *
- * This function calculates proper frequenmcy out from the timer and cpu clock (it's not universal calculator though)
- * and sets it. If the input parameter equals 0, then the frequency is taken from control input.
+ * @brief Half period of the output is made of several timer periods (segments).
  *
- * @param frequency to be set, set to 0 if the frequency should be taken from control input
+ * Called from compare match interrupt at the end of each segment. The output is changed only at the end of the last
+ * segment, the fractional part of the half period is dithered in the last segment. In PWM the low half has its own
+ * length.
  */
-void OutputDriver_SetFrequency(uint16_t frequency)
+static inline void OutputDriver_privPerformExtendedPeriod()
 {
+    uint16_t segment = hOutput.synth.segment + 1;
+    bool     level   = hOutput.synth.level;
 
-    if(frequency == 0)
+    if(segment >= OutputDriver_privGetSegments(level))
     {
-        frequency = OutputDriver_GetControlInput();
+        // the last segment has just ended, the output has changed its level
+        segment = 0;
+        level   = !level;
     }
-    if(frequency < OUTPUT_DRIVER_MIN_FREQUENCY)
+
+    bool     lowHalf      = !level && (hOutput.synth.wave == eWAVE_PWM);
+    uint16_t last         = OutputDriver_privGetSegments(level) - 1;
+    uint8_t  ocr          = lowHalf ? hOutput.synth.lowOcr : hOutput.synth.baseOcr;
+    uint16_t longSegments = lowHalf ? hOutput.synth.lowLongSegments : hOutput.synth.longSegments;
+
+    if(segment < longSegments)
     {
-        frequency = OUTPUT_DRIVER_MIN_FREQUENCY;
+        ocr++;
     }
-    if(frequency > OUTPUT_DRIVER_MAX_FREQUENCY)
+    if(segment == last)
     {
-        frequency = OUTPUT_DRIVER_MAX_FREQUENCY;
+        uint8_t accum = hOutput.synth.accum;
+        uint8_t next  = accum + hOutput.synth.fraction;
+
+        if(next < accum)
+        {
+            ocr++;
+        }
+        hOutput.synth.accum = next;
     }
 
-    // ========================================================================
-    ASSERT(!((frequency < 1) && (frequency > OUTPUT_DRIVER_TABLE_SIZE)));
+    TIMER_HAL_SET_OCR2(ocr);
+    if(hOutput.enabled)
+    {
+        TIMER_HAL_SET_OCR2_ON_COMPARE(!hOutput.gate.closed && ((segment == last) ? !level : level));
+    }
 
-    hOutput.setFrequency = frequency;
+    hOutput.synth.segment = segment;
+    hOutput.synth.level   = level;
+}
 
-    TimerHAL_SetOCR(eTIMER_2, outputDriver_table[frequency - 1][0]);
-    OutputDriver_privSetTimerPrescaler(outputDriver_table[frequency - 1][1]);
+/**
+ * @brief Splits half period into equal segments of up to SEGMENT_MAX_TICKS.
+ *
+ * @param ticks length of the half period in timer ticks
+ * @param pOcr ocr of the shorter segment
+ * @param pSegments number of segments
+ * @param pLongSegments number of segments which are one tick longer
+ */
+static void OutputDriver_privSplitHalfPeriod(uint16_t  ticks,
+                                             uint8_t  *pOcr,
+                                             uint16_t *pSegments,
+                                             uint16_t *pLongSegments)
+{
+    uint16_t segments = (ticks + SEGMENT_MAX_TICKS - 1) / SEGMENT_MAX_TICKS;
 
-    LOG_DEBUG(
-        "OCR is:\t %d, prescaler is: %d", outputDriver_table[frequency - 1][0], outputDriver_table[frequency - 1][1]);
+    *pSegments     = segments;
+    *pOcr          = (uint8_t)(ticks / segments - 1);
+    *pLongSegments = ticks % segments;
 }
 
 /**
- * @brief Returns average of the control input potentiometer.
+ * @brief Calculates timer 2 settings for given frequency.
  *
- * @return Value from potentiometer from 0 to 99
+ * The lowest possible prescaler is selected and the half period is calculated with 1/256 of timer tick resolution.
+ * If the half period has a fractional part, OCR is dithered in the compare match interrupt between two neighbouring
+ * values. Dithering needs at least OUTPUT_DRIVER_DITHER_MIN_CYCLES between compare matches, above that frequency the
+ * closest OCR is used. Frequencies too low for timer 2 with 1024 prescaler are made of several timer periods counted
+ * in the compare match interrupt.
+ *
+ * @param frequency in Hz
+ * @param pSynth calculated settings
+ * @return half period in 1/256 of timer tick
  */
-uint16_t OutputDriver_GetControlInput()
+static uint32_t OutputDriver_privCalculateSynth(uint32_t frequency, OutputDriver_Synth_t *pSynth)
 {
-    int32_t  controlInput = 0;
-    uint16_t maxAdcValue  = 0;
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    uint32_t period    = 0;
+    uint8_t  prescaler = 1;
+
+    *pSynth          = (OutputDriver_Synth_t){0};
+    pSynth->segments = 1;
+
+    // The lowest prescaler gives the best resolution
+    for(prescaler = 1; prescaler <= OUTPUT_DRIVER_PRESCALERS; prescaler++)
+    {
+        uint32_t timerClock = TIMER_CLOCK_FRACTIONAL >> OUTPUT_DRIVER_PRESCALER_SHIFT_GET(prescaler);
+
+        period = (timerClock + frequency) / (2 * frequency);
+        if(period <= PERIOD_MAX)
+        {
+            break;
+        }
+    }
+
+    if(prescaler > OUTPUT_DRIVER_PRESCALERS)
+    {
+        // Too low for the timer, the half period is split into equal segments of up to SEGMENT_MAX_TICKS
+        uint16_t ticks = (uint16_t)(period >> PERIOD_FRACTION_BITS);
+
+        prescaler = OUTPUT_DRIVER_PRESCALERS;
+        OutputDriver_privSplitHalfPeriod(ticks, &pSynth->baseOcr, &pSynth->segments, &pSynth->longSegments);
+        pSynth->useIsr = true;
+    }
+    else
+    {
+        if((period & 0xFF) != 0)
+        {
+            uint32_t cycles = (period >> PERIOD_FRACTION_BITS) << OUTPUT_DRIVER_PRESCALER_SHIFT_GET(prescaler);
+            pSynth->useIsr  = (cycles >= OUTPUT_DRIVER_DITHER_MIN_CYCLES);
+        }
+        if(!pSynth->useIsr)
+        {
+            // round to the closest whole tick
+            period = (period + 0x80) & ~0xFFUL;
+        }
+        pSynth->baseOcr = (uint8_t)((period >> PERIOD_FRACTION_BITS) - 1);
+    }
+
+    pSynth->fraction  = (uint8_t)period;
+    pSynth->prescaler = prescaler;
+
+    return period;
+}
+
+/**
+ * @brief Writes settings into timer 2. Called with interrupts disabled, right after the compare match if the timer
+ * runs.
+ *
+ * Ticks counted since the compare match are converted to the new prescaler, so the running half period gets exactly
+ * the new length. If it is already longer than that, it is ended immediately.
+ *
+ * @param pSynth settings to be written
+ * @param atMatch true if the timer is running and the compare match has just happened
+ */
+static void OutputDriver_privLoadSynth(const volatile OutputDriver_Synth_t *pSynth, bool atMatch)
+{
+    uint8_t             counted      = TIMER_HAL_GET_TCNT2();
+    uint8_t             oldPrescaler = hOutput.synth.prescaler;
+    OutputDriver_Wave_e oldWave      = hOutput.synth.wave;
+    uint8_t             ocr;
+    bool                constant     = (pSynth->wave == eWAVE_LOW) || (pSynth->wave == eWAVE_HIGH);
+
+    TIMER_HAL_DISABLE_OCR2_INTERRUPT();
+    hOutput.pendingValid = false;
+    if(constant)
+    {
+        // Timer keeps running as it is, the running half period is finished before the output stays at the level
+        ocr                     = TIMER_HAL_GET_OCR2();
+        hOutput.synth.wave      = pSynth->wave;
+        hOutput.synth.useIsr    = false;
+        hOutput.synth.segments  = 1;
+        hOutput.synth.segment   = 0;
+        hOutput.synth.prescaler = (oldPrescaler != 0) ? oldPrescaler : pSynth->prescaler;
+        if(oldWave == eWAVE_FAST_PWM)
+        {
+            TIMER_HAL_SET_TIMER2_CTC();
+            TIMER_HAL_SET_TCNT2(0);
+        }
+    }
+    else
+    {
+        hOutput.synth = *pSynth;
+        if(atMatch)
+        {
+            hOutput.synth.level = GPIO_IN_GET_OUT_KEY() ? true : false;
+        }
+        ocr = OutputDriver_privGetFirstOcr(hOutput.synth.level);
+        TimerHAL_SetOCR(eTIMER_2, ocr);
+    }
+
+    if(atMatch && !constant)
     {
-        uint32_t accum = 0;
+        if(oldWave == eWAVE_FAST_PWM)
+        {
+            // Hardware PWM has just cleared the output, the new half period starts low from now
+            counted = 0;
+            TIMER_HAL_SET_TCNT2(0);
+        }
+        else if((oldPrescaler != pSynth->prescaler) && (pSynth->wave != eWAVE_FAST_PWM))
+        {
+            uint32_t cycles = (uint32_t)counted << OUTPUT_DRIVER_PRESCALER_SHIFT_GET(oldPrescaler);
+            uint32_t ticks  = cycles >> OUTPUT_DRIVER_PRESCALER_SHIFT_GET(pSynth->prescaler);
 
-        for(uint8_t i = 0; i < OUTPUT_DRIVER_CONTROL_IN_SAMPLES; i++)
+            counted = (ticks > UINT8_MAX) ? UINT8_MAX : (uint8_t)ticks;
+            if(counted < ocr)
+            {
+                TIMER_HAL_SET_TCNT2(counted);
+            }
+        }
+        if((counted >= ocr) && (pSynth->wave != eWAVE_FAST_PWM))
         {
-            accum += hOutput.controlInputSamples[i];
+            // Compare match would be missed and the counter would wrap through 255
+            TIMER_HAL_FORCE_OCR2();
+            TIMER_HAL_SET_TCNT2(0);
+            OutputDriver_privPerformPulse();
+            hOutput.synth.level = GPIO_IN_GET_OUT_KEY() ? true : false;
+            TimerHAL_SetOCR(eTIMER_2, OutputDriver_privGetFirstOcr(hOutput.synth.level));
         }
+    }
+
+    if(pSynth->wave == eWAVE_FAST_PWM)
+    {
+        TIMER_HAL_SET_TIMER2_FAST_PWM();
+    }
+    else if(!constant)
+    {
+        TIMER_HAL_SET_TIMER2_CTC();
+    }
+    OutputDriver_privSetTimerPrescaler(hOutput.synth.prescaler);
+    if(OutputDriver_IsPulseActive() && !OutputDriver_privIsPulseCapable())
+    {
+        // Edges of the new settings can not be counted, the train is ended here
+        hOutput.pulse.state = ePULSE_STATE_DONE;
+    }
+    if(hOutput.enabled)
+    {
+        OutputDriver_privConnectOutput();
+    }
+    if((pSynth->useIsr || OutputDriver_IsPulseActive()) && !TIMER_HAL_IS_OCR2_INTERRUPT())
+    {
+        // the flag is set by each compare match also while the interrupt is off, it is not a new edge
+        TIMER_HAL_CLEAR_OCR2_FLAG();
+        TIMER_HAL_ENABLE_OCR2_INTERRUPT();
+    }
+}
+
+/**
+ * @brief Checks if the running half period is shorter than the compare match interrupt latency.
+ *
+ * Such a compare match is over before its interrupt writes anything, the interrupt is then used only to load new
+ * settings. Hardware PWM makes the compare match once per 256 ticks.
+ */
+static inline bool OutputDriver_privIsPeriodShort()
+{
+    uint8_t  shift  = OUTPUT_DRIVER_PRESCALER_SHIFT_GET(hOutput.synth.prescaler);
+    uint16_t ticks  = (hOutput.synth.wave == eWAVE_FAST_PWM) ? 256 : ((uint16_t)TIMER_HAL_GET_OCR2() + 1);
+    uint32_t cycles = (uint32_t)ticks << shift;
+
+    return !hOutput.synth.useIsr && (cycles < OUTPUT_DRIVER_DITHER_MIN_CYCLES);
+}
 
-        hOutput.rawControlInput = accum / OUTPUT_DRIVER_CONTROL_IN_SAMPLES;
+/**
+ * @brief Applies calculated settings at the next compare match, so there is no runt nor stretched period.
+ *
+ * Must be called with interrupts disabled (atomic block or ISR). The settings are staged for the compare match
+ * interrupt, so the caller never waits for the compare match with interrupts disabled, see
+ * OutputDriver_PerformCompareMatch. Stopped timer is written immediately.
+ *
+ * @param pSynth settings to be applied
+ */
+static void OutputDriver_privApplySynth(const OutputDriver_Synth_t *pSynth)
+{
+    if(!TimerHAL_IsTimerEnabled(eTIMER_2) || (hOutput.synth.prescaler == 0))
+    {
+        OutputDriver_privLoadSynth(pSynth, false);
+        return;
     }
 
-    maxAdcValue = OutputDriver_privGetControlInputMaxAdcValue();
-    if(hOutput.rawControlInput > maxAdcValue)
+    hOutput.pending      = *pSynth;
+    hOutput.pendingValid = true;
+    if(!TIMER_HAL_IS_OCR2_INTERRUPT())
     {
-        hOutput.rawControlInput = maxAdcValue;
+        // a stale flag would load the settings right now instead of at the next compare match
+        TIMER_HAL_CLEAR_OCR2_FLAG();
+        TIMER_HAL_ENABLE_OCR2_INTERRUPT();
     }
+}
+
+/**
+ * @brief Applies precalculated step of the sweep. Called with interrupts disabled.
+ *
+ * @param step index of the step
+ */
+static void OutputDriver_privApplySweepStep(uint8_t step)
+{
+    OutputDriver_Synth_t synth = {.segments = 1};
 
-    LOG_DEBUG("Raw control input is: %d", hOutput.rawControlInput);
+    synth.baseOcr   = hOutput.sweep.steps[step].ocr;
+    synth.fraction  = hOutput.sweep.steps[step].fraction;
+    synth.prescaler = hOutput.sweep.steps[step].prescaler;
+    synth.useIsr    = hOutput.sweep.steps[step].dither;
+
+    OutputDriver_privApplySynth(&synth);
+
+    // Remainder of updates is spread over steps (Bresenham), so the overall duration is kept without division
+    hOutput.sweep.updatesLeft = hOutput.sweep.updatesPerStep;
+    hOutput.sweep.extraAccum += hOutput.sweep.extraUpdates;
+    if(hOutput.sweep.extraAccum >= hOutput.sweep.stepsCount)
+    {
+        hOutput.sweep.extraAccum -= hOutput.sweep.stepsCount;
+        hOutput.sweep.updatesLeft++;
+    }
+}
 
-    controlInput = (maxAdcValue - hOutput.rawControlInput);
-    controlInput = (controlInput * 100) / maxAdcValue;
+/**
+ * @brief Returns maximum of the control input ADC value for the actual supply voltage.
+ *
+ * The calibration curve is interpolated between the points of the generated table. The voltage is clamped to
+ * OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE..OUTPUT_DRIVER_BATTERY_MAX_VOLTAGE first, so the index is at most
+ * OUTPUT_DRIVER_BATTERY_TABLE_SIZE - 2 and both read points are inside the table. The generator checks that the
+ * product fits into int16_t.
+ *
+ * @return ADC value for the knob at its end
+ */
+static uint16_t OutputDriver_privGetControlInputMaxAdcValue()
+{
+    uint16_t voltage = Adc_GetSupplyVoltage();
+
+    if(voltage < OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE)
+    {
+        voltage = OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE;
+    }
+    if(voltage > OUTPUT_DRIVER_BATTERY_MAX_VOLTAGE)
+    {
+        voltage = OUTPUT_DRIVER_BATTERY_MAX_VOLTAGE;
+    }
+    voltage -= OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE;
+
+    uint8_t  index    = voltage >> OUTPUT_DRIVER_BATTERY_SHIFT;
+    uint8_t  fraction = voltage & ((1U << OUTPUT_DRIVER_BATTERY_SHIFT) - 1);
+    uint16_t base     = OUTPUT_DRIVER_BATTERY_TABLE_GET(index);
+    int16_t  delta    = (int16_t)(OUTPUT_DRIVER_BATTERY_TABLE_GET(index + 1) - base);
+
+    return base + ((delta * fraction + (1 << (OUTPUT_DRIVER_BATTERY_SHIFT - 1))) >> OUTPUT_DRIVER_BATTERY_SHIFT);
+}
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+/**
+ * @brief Adds measurement to the running sum of the control input.
+ *
+ * Called from the ADC interrupt, the oldest sample is replaced, so the sum is kept without summing all samples.
+ *
+ * @param measurement Input value to be processed
+ */
+void OutputDriver_PerformControlInput(uint16_t measurement)
+{
+    uint8_t  position = hOutput.control.position;
+    uint16_t sample   = (measurement > CONTROL_INPUT_OFFSET) ? (measurement - CONTROL_INPUT_OFFSET) : 0;
+
+    hOutput.control.sum += sample - hOutput.control.samples[position];
+    hOutput.control.samples[position] = sample;
+    hOutput.control.updated           = true;
+
+    position++;
+    if(position >= OUTPUT_DRIVER_CONTROL_IN_SAMPLES)
+    {
+        position = 0;
+    }
+    hOutput.control.position = position;
+}
+
+/**
+ * @brief Dithers OCR value between two neighbouring values or extends the half period in software.
+ *
+ * Called from timer 2 compare match interrupt, only when the set frequency needs it or new settings are waiting.
+ * Each compare match starts a new half period, its length is extended by one tick every time the phase accumulator
+ * overflows. Waiting settings are loaded at the end of the half period. A half period shorter than the interrupt
+ * latency may be over already, so the next compare match is polled here. It comes within
+ * OUTPUT_DRIVER_DITHER_MIN_CYCLES and delays only the other interrupts, which tolerate it.
+ */
+void OutputDriver_PerformCompareMatch()
+{
+    if(hOutput.pulse.state != ePULSE_STATE_IDLE)
+    {
+        OutputDriver_privPerformPulse();
+        if((hOutput.pulse.state == ePULSE_STATE_DONE) && !hOutput.synth.useIsr && !hOutput.pendingValid)
+        {
+            TIMER_HAL_DISABLE_OCR2_INTERRUPT();
+            return;
+        }
+    }
+
+    if(hOutput.pendingValid &&
+       (hOutput.synth.segment == (uint16_t)(OutputDriver_privGetSegments(hOutput.synth.level) - 1)))
+    {
+        if(OutputDriver_privIsPeriodShort())
+        {
+            TIMER_HAL_CLEAR_OCR2_FLAG();
+            while(!TIMER_HAL_IS_OCR2_FLAG())
+            {
+                ;
+            }
+        }
+        OutputDriver_privLoadSynth(&hOutput.pending, true);
+        return;
+    }
+
+    if(OutputDriver_privIsExtended())
+    {
+        OutputDriver_privPerformExtendedPeriod();
+        return;
+    }
+
+    uint8_t accum = hOutput.synth.accum;
+    uint8_t next  = accum + hOutput.synth.fraction;
+    uint8_t ocr   = hOutput.synth.baseOcr;
+
+    if(next < accum)
+    {
+        ocr++;
+    }
+    hOutput.synth.accum = next;
+
+    TIMER_HAL_SET_OCR2(ocr);
+}
+
+/**
+ * @brief Initializes Output driver.
+ *
+ * Timer 1 must be initialized before this function call.
+ *
+ */
+void OutputDriver_Init()
+{
+    TimerHAL_StartTimer(eTIMER_2);
+}
+
+/**
+ * @brief Enables output
+ *
+ */
+void OutputDriver_Enable()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.pulse.state = ePULSE_STATE_IDLE;
+        OutputDriver_privConnectOutput();
+        hOutput.enabled = true;
+    }
+}
+
+/**
+ * @brief Disables output
+ *
+ */
+void OutputDriver_Disable()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.enabled     = false;
+        hOutput.pulse.state = ePULSE_STATE_IDLE;
+        TIMER_HAL_DISABLE_OCR2();
+    }
+}
+
+/**
+ * @brief Set the frequency based on the input parameter.
+ *
+ * This function calculates proper frequenmcy out from the timer and cpu clock (it's not universal calculator though)
+ * and sets it. If the input parameter equals 0, then the frequency is taken from control input.
+ *
+ * @param frequency to be set, set to 0 if the frequency should be taken from control input
+ */
+void OutputDriver_SetFrequency(uint16_t frequency)
+{
+
+    if(frequency == 0)
+    {
+        frequency = OutputDriver_GetControlInput();
+    }
+    if(frequency < OUTPUT_DRIVER_MIN_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_MIN_FREQUENCY;
+    }
+    if(frequency > OUTPUT_DRIVER_MAX_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_MAX_FREQUENCY;
+    }
+
+    // ========================================================================
+    ASSERT((frequency - OUTPUT_DRIVER_MIN_FREQUENCY) < OUTPUT_DRIVER_TABLE_SIZE);
+
+    hOutput.setFrequency = frequency;
+
+    uint8_t ocr       = OUTPUT_DRIVER_TABLE_GET_OCR(frequency - OUTPUT_DRIVER_MIN_FREQUENCY);
+    uint8_t prescaler = OUTPUT_DRIVER_TABLE_GET_PRESCALER(frequency - OUTPUT_DRIVER_MIN_FREQUENCY);
+
+    // Table values do not need dithering
+    OutputDriver_Synth_t synth = {.baseOcr = ocr, .segments = 1, .prescaler = prescaler};
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.sweep.state = eSWEEP_STATE_IDLE;
+        OutputDriver_privApplySynth(&synth);
+    }
+
+    hOutput.actualFrequency =
+        OutputDriver_privCalculateFrequency(prescaler, (uint32_t)(ocr + 1) << PERIOD_FRACTION_BITS);
+
+    LOG_DEBUG("OCR is:\t %d, prescaler is: %d", ocr, prescaler);
+}
+
+/**
+ * @brief Sets the output frequency with 1 Hz resolution.
+ *
+ * The lowest possible prescaler is selected and the half period is calculated with 1/256 of timer tick resolution.
+ * If the half period has a fractional part, OCR is dithered in the compare match interrupt between two neighbouring
+ * values. Dithering needs at least OUTPUT_DRIVER_DITHER_MIN_CYCLES between compare matches, the worst case latency of
+ * the compare match interrupt. So it is used up to F_CPU / (2 * OUTPUT_DRIVER_DITHER_MIN_CYCLES), 10 kHz at 8 MHz,
+ * above that frequency the closest OCR is used. Frequencies too low for timer 2 with 1024 prescaler are made of several
+ * timer periods counted in the compare match interrupt.
+ *
+ * Guaranteed error of the average frequency (apart from the cpu clock error):
+ *  - below 0.01 % if dithering or software extension is used (up to 10 kHz at 8 MHz),
+ *  - below frequency / F_CPU otherwise (e.g. 1.25 % at 100 kHz for 8 MHz).
+ * The bounds were checked with a host model of the calculation only, not measured on the target nor in a simulator.
+ *
+ * @param frequency to be set in Hz, limited to OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY..OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY
+ * @return achieved average frequency in Hz
+ */
+uint32_t OutputDriver_SetFrequencyHz(uint32_t frequency)
+{
+    OutputDriver_Synth_t synth;
+    uint32_t             period;
+
+    if(frequency < OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY;
+    }
+    if(frequency > OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY;
+    }
+
+    period = OutputDriver_privCalculateSynth(frequency, &synth);
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.sweep.state = eSWEEP_STATE_IDLE;
+        OutputDriver_privApplySynth(&synth);
+    }
+
+    hOutput.actualFrequency = OutputDriver_privCalculateFrequency(synth.prescaler, period);
+
+    LOG_DEBUG("OCR is:\t %d + %d/256, segments: %u, prescaler is: %d",
+              synth.baseOcr,
+              synth.fraction,
+              synth.segments,
+              synth.prescaler);
+
+    return hOutput.actualFrequency;
+}
+
+/**
+ * @brief Sets PWM output with independent frequency and duty cycle.
+ *
+ * Period and prescaler are taken from the generated table. The compare match interrupt switches the output between
+ * the high and the low part, a part longer than the timer period is split into segments. Both parts need at least
+ * OUTPUT_DRIVER_DITHER_MIN_CYCLES. Otherwise hardware fast PWM is used, but only if its closest frequency
+ * (F_CPU / (256 * N)) is within OUTPUT_DRIVER_TABLE_MAX_ERROR of the requested one. The generated report lists which
+ * mode each frequency gets. Duty 0 and 100 % keep the output at constant level. Running sweep is stopped.
+ *
+ * @param frequency in kHz, limited to OUTPUT_DRIVER_MIN_FREQUENCY..OUTPUT_DRIVER_MAX_FREQUENCY
+ * @param duty in %
+ * @return true if set, false if neither mode makes this frequency and duty, the output is left unchanged then
+ */
+bool OutputDriver_SetPwm(uint16_t frequency, uint8_t duty)
+{
+    OutputDriver_Synth_t synth  = {.segments = 1};
+    uint32_t             actual = 0;
+
+    if(frequency < OUTPUT_DRIVER_MIN_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_MIN_FREQUENCY;
+    }
+    if(frequency > OUTPUT_DRIVER_MAX_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_MAX_FREQUENCY;
+    }
+
+    uint16_t period = OUTPUT_DRIVER_PWM_TABLE_GET_PERIOD(frequency - OUTPUT_DRIVER_MIN_FREQUENCY);
+    uint16_t high   = ((uint32_t)period * duty + 50) / 100;
+    uint16_t low    = period - high;
+
+    synth.prescaler = OUTPUT_DRIVER_PWM_TABLE_GET_PRESCALER(frequency - OUTPUT_DRIVER_MIN_FREQUENCY);
+    uint8_t shift   = OUTPUT_DRIVER_PRESCALER_SHIFT_GET(synth.prescaler);
+
+    if(duty == 0)
+    {
+        synth.wave = eWAVE_LOW;
+    }
+    else if(duty >= 100)
+    {
+        synth.wave = eWAVE_HIGH;
+    }
+    else if((((uint32_t)high << shift) >= OUTPUT_DRIVER_DITHER_MIN_CYCLES) &&
+            (((uint32_t)low << shift) >= OUTPUT_DRIVER_DITHER_MIN_CYCLES))
+    {
+        synth.wave   = eWAVE_PWM;
+        synth.useIsr = true;
+        OutputDriver_privSplitHalfPeriod(high, &synth.baseOcr, &synth.segments, &synth.longSegments);
+        OutputDriver_privSplitHalfPeriod(low, &synth.lowOcr, &synth.lowSegments, &synth.lowLongSegments);
+        actual = (F_CPU >> shift) / period;
+    }
+    else
+    {
+        // Too short for the interrupt, hardware PWM period is 256 ticks
+        uint32_t target = (uint32_t)frequency * 1000;
+        uint32_t error  = UINT32_MAX;
+
+        synth.wave    = eWAVE_FAST_PWM;
+        synth.baseOcr = (uint8_t)((((uint16_t)duty << 8) + 50) / 100 - 1);
+        for(uint8_t prescaler = 1; prescaler <= OUTPUT_DRIVER_PRESCALERS; prescaler++)
+        {
+            uint32_t pwmFrequency = F_CPU >> (8 + OUTPUT_DRIVER_PRESCALER_SHIFT_GET(prescaler));
+            uint32_t pwmError     = (pwmFrequency > target) ? (pwmFrequency - target) : (target - pwmFrequency);
+
+            if(pwmError < error)
+            {
+                error           = pwmError;
+                synth.prescaler = prescaler;
+                actual          = pwmFrequency;
+            }
+        }
+
+        // same limit as the generated table, OUTPUT_DRIVER_TABLE_MAX_ERROR is in 0.1 %
+        if((error * 1000) > (target * OUTPUT_DRIVER_TABLE_MAX_ERROR))
+        {
+            LOG_WARN("PWM not possible at this frequency and duty");
+            return false;
+        }
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.sweep.state = eSWEEP_STATE_IDLE;
+        OutputDriver_privApplySynth(&synth);
+        hOutput.actualFrequency = actual;
+    }
+
+    LOG_DEBUG("PWM mode: %d, high: %u, low: %u, prescaler is: %d", synth.wave, high, low, synth.prescaler);
+
+    return true;
+}
+
+/**
+ * @brief Calculates timer settings for given frequency without applying them.
+ *
+ * Use it together with OutputDriver_ApplySetting when the frequency has to be changed at exact moment, e.g. from
+ * an interrupt. Accuracy is the same as for OutputDriver_SetFrequencyHz.
+ *
+ * @param frequency in Hz, limited to OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY..OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY
+ * @param pSetting calculated settings
+ * @return average frequency in Hz which will be achieved with these settings
+ */
+uint32_t OutputDriver_PrepareFrequencyHz(uint32_t frequency, OutputDriver_Setting_t *pSetting)
+{
+    OutputDriver_Synth_t synth;
+    uint32_t             period;
+
+    ASSERT(pSetting != NULL);
+
+    if(frequency < OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_SYNTH_MIN_FREQUENCY;
+    }
+    if(frequency > OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY;
+    }
+
+    period = OutputDriver_privCalculateSynth(frequency, &synth);
+
+    pSetting->ocr          = synth.baseOcr;
+    pSetting->fraction     = synth.fraction;
+    pSetting->prescaler    = synth.prescaler;
+    pSetting->useIsr       = synth.useIsr;
+    pSetting->segments     = synth.segments;
+    pSetting->longSegments = synth.longSegments;
+    pSetting->frequency    = OutputDriver_privCalculateFrequency(synth.prescaler, period);
+
+    return pSetting->frequency;
+}
+
+/**
+ * @brief Applies settings calculated by OutputDriver_PrepareFrequencyHz.
+ *
+ * There is no calculation nor logging inside, so it can be called from an interrupt. Running sweep is stopped.
+ *
+ * @param pSetting settings to be applied
+ */
+void OutputDriver_ApplySetting(const OutputDriver_Setting_t *pSetting)
+{
+    OutputDriver_Synth_t synth = {0};
+
+    synth.baseOcr      = pSetting->ocr;
+    synth.fraction     = pSetting->fraction;
+    synth.prescaler    = pSetting->prescaler;
+    synth.useIsr       = pSetting->useIsr;
+    synth.segments     = pSetting->segments;
+    synth.longSegments = pSetting->longSegments;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.sweep.state = eSWEEP_STATE_IDLE;
+        OutputDriver_privApplySynth(&synth);
+        hOutput.actualFrequency = pSetting->frequency;
+    }
+}
+
+/**
+ * @brief Returns average output frequency achieved by the current timer settings.
+ *
+ * It is not updated by the sweep.
+ *
+ * @return frequency in Hz
+ */
+uint32_t OutputDriver_GetFrequencyHz()
+{
+    uint32_t frequency;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        frequency = hOutput.actualFrequency;
+    }
+    return frequency;
+}
+
+/**
+ * @brief Prepares a frequency sweep.
+ *
+ * All steps are calculated here, so the interrupt only copies ready timer settings. The sweep is made of up to
+ * OUTPUT_DRIVER_SWEEP_MAX_STEPS steps, the frequency is updated every OUTPUT_DRIVER_SWEEP_UPDATE_TICKS system ticks.
+ * Running sweep is stopped. Frequencies are limited to the range which timer 2 makes without software extension.
+ * Logarithmic steps are made by a Q16 ratio in integer arithmetic, the last step is exactly the stop frequency.
+ *
+ * @param startFrequency first frequency in Hz
+ * @param stopFrequency last frequency in Hz
+ * @param duration duration of the whole sweep in ms
+ * @param type linear or logarithmic sweep
+ * @param repeat true if the sweep should start again after the last step
+ */
+void OutputDriver_SweepSetup(uint32_t                 startFrequency,
+                             uint32_t                 stopFrequency,
+                             uint32_t                 duration,
+                             OutputDriver_SweepType_e type,
+                             bool                     repeat)
+{
+    OutputDriver_SweepStep_t step;
+    OutputDriver_Synth_t     synth;
+    uint32_t                 updates;
+    uint8_t                  stepsCount = OUTPUT_DRIVER_SWEEP_MAX_STEPS;
+    uint32_t                 ratio      = 1UL << 16;
+    uint32_t                 frequency; // Q8, logarithmic steps from the lower frequency up
+
+    OutputDriver_SweepStop();
+
+    startFrequency = (startFrequency < SWEEP_MIN_FREQUENCY) ? SWEEP_MIN_FREQUENCY : startFrequency;
+    stopFrequency  = (stopFrequency < SWEEP_MIN_FREQUENCY) ? SWEEP_MIN_FREQUENCY : stopFrequency;
+    startFrequency = (startFrequency > OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY) ? OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY
+                                                                          : startFrequency;
+    stopFrequency  = (stopFrequency > OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY) ? OUTPUT_DRIVER_SYNTH_MAX_FREQUENCY
+                                                                         : stopFrequency;
+
+    updates = (duration * 1000UL) / SWEEP_UPDATE_PERIOD_US;
+    if(updates == 0)
+    {
+        updates = 1;
+    }
+    if(updates < stepsCount)
+    {
+        stepsCount = (uint8_t)updates;
+    }
+
+    uint32_t low  = (startFrequency < stopFrequency) ? startFrequency : stopFrequency;
+    uint32_t high = (startFrequency < stopFrequency) ? stopFrequency : startFrequency;
+
+    if((type == eOUTPUT_SWEEP_LOGARITHMIC) && (stepsCount > 1))
+    {
+        ratio = OutputDriver_privFindSweepRatio(low, high, stepsCount - 1);
+    }
+    frequency = low << 8;
+
+    for(uint8_t i = 0; i < stepsCount; i++)
+    {
+        uint32_t stepFrequency = startFrequency;
+        uint8_t  index         = i;
+
+        if(stepsCount > 1)
+        {
+            if(type == eOUTPUT_SWEEP_LOGARITHMIC)
+            {
+                // falling sweep is stored from the last step
+                stepFrequency = (i == (stepsCount - 1)) ? high : ((frequency + 0x80) >> 8);
+                frequency     = OutputDriver_privMulQ16(frequency, ratio);
+                index         = (startFrequency > stopFrequency) ? (stepsCount - 1 - i) : i;
+            }
+            else
+            {
+                stepFrequency += ((int32_t)(stopFrequency - startFrequency) * i) / (stepsCount - 1);
+            }
+        }
+
+        OutputDriver_privCalculateSynth(stepFrequency, &synth);
+        step.ocr       = synth.baseOcr;
+        step.fraction  = synth.fraction;
+        step.prescaler = synth.prescaler;
+        step.dither    = synth.useIsr;
+
+        hOutput.sweep.steps[index] = step;
+    }
+
+    hOutput.sweep.stepsCount     = stepsCount;
+    hOutput.sweep.updatesPerStep = updates / stepsCount;
+    hOutput.sweep.extraUpdates   = updates % stepsCount;
+    hOutput.sweep.repeat         = repeat;
+
+    LOG_DEBUG("Sweep: %u steps, %u updates per step", stepsCount, hOutput.sweep.updatesPerStep);
+}
+
+/**
+ * @brief Starts prepared sweep from the first step.
+ */
+void OutputDriver_SweepStart()
+{
+    if(hOutput.sweep.stepsCount == 0)
+    {
+        return;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.sweep.step       = 0;
+        hOutput.sweep.extraAccum = 0;
+        hOutput.sweep.ticksLeft  = OUTPUT_DRIVER_SWEEP_UPDATE_TICKS;
+        OutputDriver_privApplySweepStep(0);
+        hOutput.sweep.state = eSWEEP_STATE_RUNNING;
+    }
+}
+
+/**
+ * @brief Stops the sweep, the output keeps the current frequency.
+ */
+void OutputDriver_SweepStop()
+{
+    hOutput.sweep.state = eSWEEP_STATE_IDLE;
+}
+
+/**
+ * @brief Holds the sweep at the current step or resumes it.
+ *
+ * @param hold true to hold, false to resume
+ */
+void OutputDriver_SweepHold(bool hold)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(hold && (hOutput.sweep.state == eSWEEP_STATE_RUNNING))
+        {
+            hOutput.sweep.state = eSWEEP_STATE_HOLD;
+        }
+        else if(!hold && (hOutput.sweep.state == eSWEEP_STATE_HOLD))
+        {
+            hOutput.sweep.state = eSWEEP_STATE_RUNNING;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the sweep is running or held.
+ *
+ * @return true if the sweep is not finished or stopped
+ */
+bool OutputDriver_IsSweepActive()
+{
+    return (hOutput.sweep.state == eSWEEP_STATE_RUNNING) || (hOutput.sweep.state == eSWEEP_STATE_HOLD);
+}
+
+/**
+ * @brief Performs the sweep, call it on each system tick (timer 0 overflow).
+ *
+ * Only counts the ticks and stages precalculated settings for the timer, there is no calculation here. The system
+ * tick runs with interrupts enabled, only the staging is atomic.
+ */
+void OutputDriver_PerformSweep()
+{
+    if(hOutput.sweep.state != eSWEEP_STATE_RUNNING)
+    {
+        return;
+    }
+    if(--hOutput.sweep.ticksLeft != 0)
+    {
+        return;
+    }
+    hOutput.sweep.ticksLeft = OUTPUT_DRIVER_SWEEP_UPDATE_TICKS;
+
+    if(--hOutput.sweep.updatesLeft != 0)
+    {
+        return;
+    }
+
+    uint8_t step = hOutput.sweep.step + 1;
+    if(step >= hOutput.sweep.stepsCount)
+    {
+        if(!hOutput.sweep.repeat)
+        {
+            hOutput.sweep.state = eSWEEP_STATE_DONE;
+            return;
+        }
+        step = 0;
+    }
+    hOutput.sweep.step = step;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        OutputDriver_privApplySweepStep(step);
+    }
+}
+
+/**
+ * @brief Prepares gating of the output carrier.
+ *
+ * The carrier is switched on for duty % of each gate period and held low for the rest. Running gate continues with
+ * the new settings.
+ *
+ * @param frequency gate frequency in 0.1 Hz, limited to OUTPUT_DRIVER_GATE_MIN/MAX_FREQUENCY
+ * @param duty part of the gate period with the carrier on, in %
+ */
+void OutputDriver_GateSetup(uint16_t frequency, uint8_t duty)
+{
+    uint32_t period;
+
+    if(frequency < OUTPUT_DRIVER_GATE_MIN_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_GATE_MIN_FREQUENCY;
+    }
+    if(frequency > OUTPUT_DRIVER_GATE_MAX_FREQUENCY)
+    {
+        frequency = OUTPUT_DRIVER_GATE_MAX_FREQUENCY;
+    }
+    if(duty > 100)
+    {
+        duty = 100;
+    }
+
+    period = GATE_PERIOD_US_DIVIDEND / frequency;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.gate.period = period;
+        // full duty is the whole period, the rounded on time would close the gate at its end
+        hOutput.gate.onTime = (duty == 100) ? period : (period / 100) * duty;
+        if(hOutput.gate.phase >= period)
+        {
+            hOutput.gate.phase = 0;
+        }
+    }
+}
+
+/**
+ * @brief Starts gating, the gate period starts with the carrier on (off for zero duty).
+ */
+void OutputDriver_GateStart()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.gate.phase  = 0;
+        hOutput.gate.closed = (hOutput.gate.onTime == 0);
+        hOutput.gate.active = (hOutput.gate.period != 0);
+        if(hOutput.enabled)
+        {
+            OutputDriver_privConnectOutput();
+        }
+    }
+}
+
+/**
+ * @brief Stops gating, the carrier is on continuously.
+ */
+void OutputDriver_GateStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.gate.active = false;
+        hOutput.gate.closed = false;
+        if(hOutput.enabled)
+        {
+            OutputDriver_privConnectOutput();
+        }
+    }
+}
+
+/**
+ * @brief Opens and closes the gate, call it on each system tick (timer 0 overflow).
+ *
+ * Gate timing is kept in us, so the gate frequency does not drift and the boundaries jitter by one system tick at
+ * most. Timer 2 is never stopped nor reloaded by the gate, so the carrier edges stay on the same time grid. Closing
+ * takes effect on the next compare match, opening toggles the output high on the next compare match. Zero duty keeps
+ * the gate closed and full duty keeps it open, without a glitch at the period boundary.
+ */
+void OutputDriver_PerformGate()
+{
+    if(!hOutput.gate.active)
+    {
+        return;
+    }
+
+    uint32_t phase   = hOutput.gate.phase + TIMER_HAL_SYSTICK_PERIOD_US;
+    bool     closed  = hOutput.gate.closed;
+    bool     wrapped = (phase >= hOutput.gate.period);
+
+    if(wrapped)
+    {
+        phase -= hOutput.gate.period;
+    }
+
+    if(hOutput.gate.onTime == 0)
+    {
+        closed = true;
+    }
+    else if(hOutput.gate.onTime >= hOutput.gate.period)
+    {
+        closed = false;
+    }
+    else if(wrapped)
+    {
+        closed = false;
+    }
+    else if(phase >= hOutput.gate.onTime)
+    {
+        closed = true;
+    }
+    hOutput.gate.phase = phase;
+
+    if(closed != hOutput.gate.closed)
+    {
+        // the compare match and fast stop interrupts change the output too
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            hOutput.gate.closed = closed;
+            if(hOutput.enabled)
+            {
+                OutputDriver_privConnectOutput();
+            }
+        }
+    }
+}
+
+/**
+ * @brief Starts a train of exactly count pulses of the current carrier frequency.
+ *
+ * Edges are counted in the compare match interrupt and OC2 is disconnected right after the last falling edge. The
+ * output is enabled by this call and running gate is stopped. The carrier must be a square wave with half period of
+ * at least OUTPUT_DRIVER_PULSE_MIN_CYCLES, i.e. from SWEEP_MIN_FREQUENCY up to F_CPU / (2 *
+ * OUTPUT_DRIVER_PULSE_MIN_CYCLES), 5 kHz at 8 MHz. A frequency change out of this range ends the train.
+ *
+ * @param count number of pulses in one train
+ * @param interval time in ms the output stays low between repeated trains, 0 for a single train
+ * @return true if the train has been started
+ */
+bool OutputDriver_PulseStart(uint32_t count, uint16_t interval)
+{
+    bool started = false;
+
+    if(count == 0)
+    {
+        return false;
+    }
+
+    // Low time between trains is one half period longer than the gap counted after the last falling edge. The
+    // division is done before the atomic block, it would hold off the compare match interrupt.
+    uint32_t halfPeriods = ((uint32_t)interval * OutputDriver_GetFrequencyHz()) / PULSE_INTERVAL_DIVIDER;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if(OutputDriver_privIsPulseCapable())
+        {
+            hOutput.gate.active    = false;
+            hOutput.gate.closed    = false;
+            hOutput.pulse.count    = count;
+            hOutput.pulse.gapEdges = (interval == 0) ? 0 : ((halfPeriods > 2) ? (halfPeriods - 1) : 1);
+            hOutput.enabled        = true;
+            OutputDriver_privStartPulseTrain();
+            // the flag may be left from a compare match before the train, it would count an edge which never was
+            TIMER_HAL_CLEAR_OCR2_FLAG();
+            TIMER_HAL_ENABLE_OCR2_INTERRUPT();
+            started = true;
+        }
+    }
+
+    if(!started)
+    {
+        LOG_WARN("Pulse train not possible at this frequency");
+    }
+    return started;
+}
+
+/**
+ * @brief Stops the pulse train, the running pulse is finished first and the output stays low.
+ */
+void OutputDriver_PulseStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        hOutput.pulse.gapEdges = 0;
+        if((hOutput.pulse.state == ePULSE_STATE_RUNNING) && hOutput.pulse.high)
+        {
+            hOutput.pulse.pulsesLeft = 1;
+        }
+        else if(hOutput.pulse.state != ePULSE_STATE_IDLE)
+        {
+            TIMER_HAL_DISABLE_OCR2();
+            hOutput.pulse.state = ePULSE_STATE_DONE;
+        }
+    }
+}
+
+/**
+ * @brief Checks if the pulse train (or the gap before its repetition) is running.
+ */
+bool OutputDriver_IsPulseActive()
+{
+    OutputDriver_PulseState_e state = hOutput.pulse.state;
+
+    return (state == ePULSE_STATE_RUNNING) || (state == ePULSE_STATE_GAP);
+}
+
+/**
+ * @brief Tracks the control input, the value is recalculated only when the average leaves the hysteresis band.
+ *
+ * The band covers raw values of the current step widened by OUTPUT_DRIVER_CONTROL_IN_HYSTERESIS on both sides, so the
+ * value does not flicker between neighbouring steps. While the average stays in the band there is no division.
+ */
+static void OutputDriver_privTrackControlInput()
+{
+    uint16_t sum;
+
+    if(!hOutput.control.updated)
+    {
+        return;
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        sum                     = hOutput.control.sum;
+        hOutput.control.updated = false;
+    }
+
+    uint16_t raw = sum / OUTPUT_DRIVER_CONTROL_IN_SAMPLES;
+
+    hOutput.rawControlInput = raw;
+    if(hOutput.control.valid && (raw >= hOutput.control.bandLow) && (raw <= hOutput.control.bandHigh))
+    {
+        return;
+    }
+
+    uint16_t maxAdcValue = OutputDriver_privGetControlInputMaxAdcValue();
+    uint8_t  value;
+
+    if(raw > maxAdcValue)
+    {
+        raw = maxAdcValue;
+    }
+    value = ((uint32_t)(maxAdcValue - raw) * 100) / maxAdcValue;
+    if(value > 99)
+    {
+        value = 99;
+    }
+
+    // Raw values which give the same value: max - ceil((value + 1) * max / 100) < raw <= max - ceil(value * max / 100)
+    uint16_t low  = maxAdcValue - (((uint32_t)(value + 1) * maxAdcValue + 99) / 100) + 1;
+    uint16_t high = maxAdcValue - (((uint32_t)value * maxAdcValue + 99) / 100);
+
+    hOutput.control.bandLow  = ((value == 99) || (low < OUTPUT_DRIVER_CONTROL_IN_HYSTERESIS)) ?
+                                   0 :
+                                   (low - OUTPUT_DRIVER_CONTROL_IN_HYSTERESIS);
+    hOutput.control.bandHigh = (value == 0) ? UINT16_MAX : (high + OUTPUT_DRIVER_CONTROL_IN_HYSTERESIS);
+    hOutput.control.valid    = true;
+
+    if(value != hOutput.controlInput)
+    {
+        hOutput.controlInput    = value;
+        hOutput.control.changed = true;
+        LOG_DEBUG("Control input: %u (raw %u)", value, raw);
+    }
+}
+
+/**
+ * @brief Returns average of the control input potentiometer.
+ *
+ * @return Value from potentiometer from 0 to 99
+ */
+uint16_t OutputDriver_GetControlInput()
+{
+    OutputDriver_privTrackControlInput();
+
+    return hOutput.controlInput;
+}
+
+/**
+ * @brief Checks if the control input value has changed since the last check.
+ *
+ * @return true once after each change of the value
+ */
+bool OutputDriver_IsControlInputChanged()
+{
+    bool changed;
 
-    if(controlInput < 0)
-        controlInput = 0;
-    if(controlInput > 99)
-        controlInput = 99;
-    hOutput.controlInput = controlInput;
+    OutputDriver_privTrackControlInput();
+    changed                 = hOutput.control.changed;
+    hOutput.control.changed = false;
 
-    return controlInput;
+    return changed;
 }
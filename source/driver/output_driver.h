@@ -25,6 +25,26 @@
 // Public definitions                                                                                                //
 //===================================================================================================================//
 
+typedef enum
+{
+    eOUTPUT_SWEEP_LINEAR,
+    eOUTPUT_SWEEP_LOGARITHMIC
+} OutputDriver_SweepType_e;
+
+/**
+ * @brief Precalculated timer settings for one frequency, see OutputDriver_PrepareFrequencyHz
+ */
+typedef struct
+{
+    uint8_t  ocr;
+    uint8_t  fraction;
+    uint8_t  prescaler;
+    bool     useIsr;
+    uint16_t segments;
+    uint16_t longSegments;
+    uint32_t frequency; // achieved average frequency in Hz
+} OutputDriver_Setting_t;
+
 //===================================================================================================================//
 // Public variables                                                                                                  //
 //===================================================================================================================//
@@ -35,6 +55,8 @@
 
 void OutputDriver_PerformControlInput(uint16_t measurement);
 
+void OutputDriver_PerformCompareMatch();
+
 void OutputDriver_Init();
 
 void OutputDriver_Enable();
@@ -43,6 +65,48 @@ void OutputDriver_Disable();
 
 void OutputDriver_SetFrequency(uint16_t frequency);
 
+uint32_t OutputDriver_SetFrequencyHz(uint32_t frequency);
+
+bool OutputDriver_SetPwm(uint16_t frequency, uint8_t duty);
+
+uint32_t OutputDriver_PrepareFrequencyHz(uint32_t frequency, OutputDriver_Setting_t *pSetting);
+
+void OutputDriver_ApplySetting(const OutputDriver_Setting_t *pSetting);
+
+uint32_t OutputDriver_GetFrequencyHz();
+
+void OutputDriver_SweepSetup(uint32_t                 startFrequency,
+                             uint32_t                 stopFrequency,
+                             uint32_t                 duration,
+                             OutputDriver_SweepType_e type,
+                             bool                     repeat);
+
+void OutputDriver_SweepStart();
+
+void OutputDriver_SweepStop();
+
+void OutputDriver_SweepHold(bool hold);
+
+bool OutputDriver_IsSweepActive();
+
+void OutputDriver_PerformSweep();
+
+void OutputDriver_GateSetup(uint16_t frequency, uint8_t duty);
+
+void OutputDriver_GateStart();
+
+void OutputDriver_GateStop();
+
+void OutputDriver_PerformGate();
+
+bool OutputDriver_PulseStart(uint32_t count, uint16_t interval);
+
+void OutputDriver_PulseStop();
+
+bool OutputDriver_IsPulseActive();
+
 uint16_t OutputDriver_GetControlInput();
 
+bool OutputDriver_IsControlInputChanged();
+
 #endif // OUTPUT_DRIVER_H_
\ No newline at end of file
@@ -0,0 +1,267 @@
+/**
+ * @file clock_hal.c
+ * @addtogroup Level_1_HAL
+ *
+ * @brief Source code for calibration of the internal RC oscillator.
+ *
+ * The host sends 0x55 characters. On the line each of them is a start bit followed by alternating bits, so every low
+ * pulse is exactly one bit long, while pauses between the characters only lengthen the high level. Sum of the low
+ * pulses measured by timer 1 at cpu clock is compared with the bit time of UART_BAUDRATE at F_CPU.
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+// File specific includes
+#include "clock_hal.h"
+
+#include "global_defines.h"
+#include "system_settings.h"
+
+#include "gpio.h"
+
+// Target specific includes
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <stdlib.h>
+#include <util/delay.h>
+
+//===================================================================================================================//
+// Private macro defines                                                                                             //
+//===================================================================================================================//
+
+// Cpu cycles of all measured bits at exact F_CPU
+#define CALIBRATION_EXPECTED ((CLOCK_CALIBRATION_BITS * F_CPU + (UART_BAUDRATE / 2)) / UART_BAUDRATE)
+
+#if ((2 * CALIBRATION_EXPECTED) > UINT16_MAX)
+    #error "CLOCK_CALIBRATION_BITS is too high, the sum of bits would overflow at the highest OSCCAL"
+#endif
+#if ((CLOCK_CALIBRATION_WINDOW & (CLOCK_CALIBRATION_WINDOW - 1)) != 0) || (CLOCK_CALIBRATION_WINDOW > 64)
+    #error "CLOCK_CALIBRATION_WINDOW must be a power of 2 up to 64"
+#endif
+
+//===================================================================================================================//
+// Private definitions                                                                                               //
+//===================================================================================================================//
+
+typedef struct
+{
+    uint8_t osccal;
+    uint8_t check; // inverted osccal, erased EEPROM is not taken as calibration
+} ClockHAL_Calibration_t;
+
+//===================================================================================================================//
+// Private variables                                                                                                 //
+//===================================================================================================================//
+
+static ClockHAL_Calibration_t EEMEM clockHal_calibration;
+
+//===================================================================================================================//
+// Private functions                                                                                                 //
+//===================================================================================================================//
+
+/**
+ * @brief Changes OSCCAL by one step at a time, so the clock never jumps while the cpu runs from it.
+ */
+static void ClockHAL_privSetOsccal(uint8_t osccal)
+{
+    while(OSCCAL != osccal)
+    {
+        OSCCAL = (OSCCAL < osccal) ? (OSCCAL + 1) : (OSCCAL - 1);
+        _delay_us(10);
+    }
+}
+
+/**
+ * @brief Waits for the RX line level and returns the time stamp of timer 1.
+ *
+ * Both edges are polled by the same loop, so its latency is cancelled in the pulse width.
+ *
+ * @param level level to be waited for
+ * @param pTime timer 1 value right after the level was found
+ * @return false if the level has not come in CLOCK_CALIBRATION_TIMEOUT timer overflows
+ */
+static bool ClockHAL_privWaitLevel(bool level, uint16_t *pTime)
+{
+    uint8_t overflows = 0;
+
+    TIFR = _BV(TOV1);
+    while((GPIO_IN_GET_UART_RX() ? true : false) != level)
+    {
+        if(TIFR & _BV(TOV1))
+        {
+            TIFR = _BV(TOV1);
+            if(++overflows >= CLOCK_CALIBRATION_TIMEOUT)
+            {
+                return false;
+            }
+        }
+    }
+    *pTime = TCNT1;
+
+    return true;
+}
+
+/**
+ * @brief Measures CLOCK_CALIBRATION_BITS low pulses on the RX line.
+ *
+ * @param pCycles sum of the pulse widths in cpu cycles
+ * @return false if the host is not sending
+ */
+static bool ClockHAL_privMeasure(uint16_t *pCycles)
+{
+    uint16_t sum = 0;
+    uint16_t start;
+    uint16_t stop;
+
+    for(uint8_t i = 0; i < CLOCK_CALIBRATION_BITS; i++)
+    {
+        if(!ClockHAL_privWaitLevel(true, &stop) || !ClockHAL_privWaitLevel(false, &start) ||
+           !ClockHAL_privWaitLevel(true, &stop))
+        {
+            return false;
+        }
+        sum += stop - start;
+    }
+    *pCycles = sum;
+
+    return true;
+}
+
+/**
+ * @brief Measures the clock error for given OSCCAL.
+ *
+ * @param osccal value to be measured
+ * @param pError difference of the measured and expected cycles, positive if the clock is faster
+ * @return false if the host is not sending
+ */
+static bool ClockHAL_privMeasureError(uint8_t osccal, int16_t *pError)
+{
+    uint16_t cycles;
+
+    ClockHAL_privSetOsccal(osccal);
+    if(!ClockHAL_privMeasure(&cycles))
+    {
+        return false;
+    }
+    *pError = (int16_t)(cycles - CALIBRATION_EXPECTED);
+
+    return true;
+}
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+/**
+ * @brief Applies OSCCAL stored in EEPROM, the factory value is kept if there is no valid calibration.
+ *
+ * Call it before the UART is initialized, so the baudrate is already right.
+ */
+void ClockHAL_LoadCalibration()
+{
+    ClockHAL_Calibration_t calibration;
+
+    eeprom_read_block(&calibration, &clockHal_calibration, sizeof(calibration));
+    if((uint8_t)(calibration.check ^ calibration.osccal) == UINT8_MAX)
+    {
+        ClockHAL_privSetOsccal(calibration.osccal);
+    }
+}
+
+/**
+ * @brief Calibrates OSCCAL against 0x55 characters sent by the host and stores it in EEPROM.
+ *
+ * OSCCAL is found by binary search (the frequency rises with OSCCAL), the closer of the found value and the next one
+ * is kept. Only CLOCK_CALIBRATION_WINDOW steps around the current OSCCAL (the factory or the stored calibration) are
+ * probed. A search over the whole range would clock the cpu up to about twice F_CPU, above its limit at low supply
+ * voltage. A clock which is off by more than the window is only moved to the window edge.
+ *
+ * Timer 1 and the UART receiver are borrowed, so it must be called before timer 1 is initialized and with interrupts
+ * disabled. Nothing can be logged during the search, as the baudrate changes with OSCCAL. If the host stops sending,
+ * the original OSCCAL is restored.
+ *
+ * @param pError residual frequency error in 0.01 %, positive if the clock is faster
+ * @return true if calibrated, false if the host was not sending
+ */
+bool ClockHAL_Calibrate(int16_t *pError)
+{
+    uint8_t  original = OSCCAL;
+    uint8_t  low      = (original > CLOCK_CALIBRATION_WINDOW) ? (original - CLOCK_CALIBRATION_WINDOW) : 0;
+    uint16_t high     = (uint16_t)original + CLOCK_CALIBRATION_WINDOW;
+    uint16_t osccal   = low;
+    uint8_t  best     = original;
+    int16_t  bestError;
+    int16_t  error;
+    bool     done     = false;
+
+    if(high > UINT8_MAX)
+    {
+        high = UINT8_MAX;
+    }
+
+    // RX pin is read as GPIO, timer 1 counts cpu cycles
+    UCSRB &= ~_BV(RXEN);
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    if(ClockHAL_privMeasureError(original, &bestError))
+    {
+        done = true;
+        // offsets from the window start, the window is 2 * CLOCK_CALIBRATION_WINDOW + 1 values
+        for(uint8_t bit = CLOCK_CALIBRATION_WINDOW; bit != 0; bit >>= 1)
+        {
+            uint16_t probe = osccal + bit;
+
+            if(probe > high)
+            {
+                // out of the window, as if the clock was faster
+                continue;
+            }
+            if(!ClockHAL_privMeasureError(probe, &error))
+            {
+                done = false;
+                break;
+            }
+            if(error <= 0)
+            {
+                // clock is still slower, the bit is kept
+                osccal = probe;
+            }
+            if(abs(error) < abs(bestError))
+            {
+                best      = probe;
+                bestError = error;
+            }
+        }
+        if(done && (osccal < high))
+        {
+            done = ClockHAL_privMeasureError(osccal + 1, &error);
+            if(done && (abs(error) < abs(bestError)))
+            {
+                best      = osccal + 1;
+                bestError = error;
+            }
+        }
+    }
+
+    TCCR1B = 0;
+    TCNT1  = 0;
+
+    if(!done)
+    {
+        ClockHAL_privSetOsccal(original);
+        UCSRB |= _BV(RXEN);
+        return false;
+    }
+
+    ClockHAL_privSetOsccal(best);
+    UCSRB |= _BV(RXEN);
+    eeprom_update_block(&(ClockHAL_Calibration_t){.osccal = best, .check = (uint8_t)~best},
+                        &clockHal_calibration,
+                        sizeof(ClockHAL_Calibration_t));
+
+    *pError = (int16_t)(((int32_t)bestError * 10000) / (int32_t)CALIBRATION_EXPECTED);
+
+    return true;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file clock_hal.h
+ * @addtogroup Level_1_HAL
+ *
+ * @brief Header file for calibration of the internal RC oscillator
+ *
+ * The cpu runs from the internal 8 MHz RC oscillator, its error goes directly into the output frequency and the UART
+ * baudrate. OSCCAL is calibrated against the bit timing of the host UART and stored in EEPROM.
+ *
+ * @author domis
+ * @date 18.10.2026
+ */
+
+#ifndef CLOCK_HAL_H_
+#define CLOCK_HAL_H_
+
+// File specific includes
+#include "global_defines.h"
+
+// Target specific includes
+
+//===================================================================================================================//
+// Public macro defines                                                                                              //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public definitions                                                                                                //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public variables                                                                                                  //
+//===================================================================================================================//
+
+//===================================================================================================================//
+// Public functions                                                                                                  //
+//===================================================================================================================//
+
+/**
+ * @brief Applies OSCCAL stored in EEPROM, the factory value is kept if there is no valid calibration.
+ *
+ * Call it before the UART is initialized.
+ */
+void ClockHAL_LoadCalibration();
+
+/**
+ * @brief Calibrates OSCCAL against 0x55 characters sent by the host and stores it in EEPROM.
+ *
+ * @param pError residual frequency error in 0.01 %, positive if the clock is faster
+ * @return true if calibrated, false if the host was not sending
+ */
+bool ClockHAL_Calibrate(int16_t *pError);
+
+#endif // CLOCK_HAL_H_
@@ -16,6 +16,7 @@
 
 #include "global_defines.h"
 #include "system_settings.h"
+#include "timer_hal.h"
 
 // Target specific includes
 #include <avr/interrupt.h>
@@ -23,50 +24,69 @@
 #include <util/atomic.h>
 #include <util/delay.h>
 
-#define GPIO_INPUT_BUTTON_LEVEL_ON  0
-#define GPIO_INPUT_BUTTON_LEVEL_OFF 1
+// Both buttons are sampled with one read of their input register
+#if (PIN_PORT_ID(SWITCH_A) != PIN_PORT_ID(SWITCH_B))
+    #error "Buttons must be on the same port"
+#endif
+
+// The vertical counter has two bits, an input changes after four equal samples
+#if (GPIO_DEBOUNCE_TIME != 4)
+    #error "GPIO_DEBOUNCE_TIME must be 4 samples"
+#endif
+
+#define GPIO_BUTTON_PIN    PIN_REG(PIN, SWITCH_A)
+#define GPIO_BUTTON_A_MASK PIN_MASK(SWITCH_A)
+#define GPIO_BUTTON_B_MASK PIN_MASK(SWITCH_B)
+#define GPIO_BUTTONS_MASK  (GPIO_BUTTON_A_MASK | GPIO_BUTTON_B_MASK)
+
+// Indexes are free running 8 bit values, the size must divide their range
+#if ((GPIO_EVENT_QUEUE_SIZE & (GPIO_EVENT_QUEUE_SIZE - 1)) != 0) || (GPIO_EVENT_QUEUE_SIZE > 128)
+    #error "GPIO_EVENT_QUEUE_SIZE must be a power of 2 up to 128"
+#endif
+#define GPIO_EVENT_INDEX(index) ((index) & (GPIO_EVENT_QUEUE_SIZE - 1))
 
 //===================================================================================================================//
 // Private variables                                                                                                 //
 //===================================================================================================================//
 
-Gpio_Button_t hButton[2] = {
-    // Button A
-    {
-        .debounce =
-            {
-                .oldValue       = GPIO_INPUT_BUTTON_LEVEL_OFF,
-                .debouncedValue = GPIO_INPUT_BUTTON_LEVEL_OFF,
-                .counter        = GPIO_DEBOUNCE_TIME,
-            },
-        .status = eBUTTON_STATUS_IDLE,
-        .input  = GPIO_INPUT_BUTTON_LEVEL_OFF,
-    },
-    // Button B
-    {
-        .debounce =
-            {
-                .oldValue       = GPIO_INPUT_BUTTON_LEVEL_OFF,
-                .debouncedValue = GPIO_INPUT_BUTTON_LEVEL_OFF,
-                .counter        = GPIO_DEBOUNCE_TIME,
-            },
-        .status = eBUTTON_STATUS_IDLE,
-        .input  = GPIO_INPUT_BUTTON_LEVEL_OFF,
-    }};
+// Filled from Gpio_ButtonsPerform, drained by Gpio_GetEvent
+static volatile Gpio_EventQueue_t hEvents;
+
+// Accessed only from Gpio_ButtonsPerform
+static Gpio_Gesture_t hGesture[2];
+
+static volatile Gpio_FastStop_t hFastStop;
+
+// Accessed only from Gpio_ButtonsPerform, counters start at 3 (0b11)
+static Gpio_Debouncer_t hDebouncer = {
+    .state  = 0,
+    .count0 = UINT8_MAX,
+    .count1 = UINT8_MAX,
+};
 
 //===================================================================================================================//
 // Interrupt vectors                                                                                                 //
 //===================================================================================================================//
 
-ISR(INT0_vect)
+__weak void Gpio_FastStopCallback()
 {
-
-    hButton[eGPIO_BUTTON_A].input = GPIO_IN_GET_SWITCH_A();
+    ;
 }
 
-ISR(INT1_vect)
+ISR(INT0_vect)
 {
-    hButton[eGPIO_BUTTON_B].input = GPIO_IN_GET_SWITCH_B();
+    // qualified only if the button is still held, a short spike is ignored
+    if(GPIO_IN_GET_SWITCH_A())
+    {
+        return;
+    }
+
+    Gpio_FastStopCallback();
+
+    // one shot, the button would bounce
+    GICR &= ~_BV(INT0);
+    hFastStop.state     = eGPIO_FAST_STOP_TRIGGERED;
+    hFastStop.triggered = true;
 }
 
 //===================================================================================================================//
@@ -74,63 +94,160 @@ ISR(INT1_vect)
 //===================================================================================================================//
 
 /**
- * @brief Debounces a level given in the input object.
+ * @brief Debounces all inputs of one port in parallel.
  *
- * The debounce time is configured in GPIO_DEBOUNCE_TIME
+ * Each input has its own two bit counter whose bits are stored in count0 and count1 (vertical counter). The counter
+ * counts down while the sample differs from the debounced state and it is reset to 3 when they are equal again. The
+ * state of the input toggles when its counter wraps around, so after four equal samples.
  *
- * @related GPIO_DEBOUNCE_TIME
- * @param pButton pointer to the debounced object structure
- * @param currentValue current (at this moment) value to be debounced
- * @return true if input is valid, false otherwise
+ * @param pDebouncer pointer to the debouncer
+ * @param sample current value of the inputs, 1 = active
+ * @return mask of inputs whose debounced state changed
  */
-static bool Gpio_privDebounce(Gpio_Debouncer_t *pButton, uint8_t currentValue)
+static inline uint8_t Gpio_privDebounce(Gpio_Debouncer_t *pDebouncer, uint8_t sample)
 {
-    bool changed = false;
+    uint8_t delta = sample ^ pDebouncer->state;
 
-    if(currentValue != pButton->oldValue)
+    pDebouncer->count0 = ~(pDebouncer->count0 & delta);
+    pDebouncer->count1 = pDebouncer->count0 ^ (pDebouncer->count1 & delta);
+
+    delta &= pDebouncer->count0 & pDebouncer->count1;
+    pDebouncer->state ^= delta;
+
+    return delta;
+}
+
+/**
+ * @brief Stores the event to the queue, called only from the system tick.
+ *
+ * If the queue is full, the new event is dropped and counted, the stored ones are kept.
+ */
+static void Gpio_privPushEvent(Gpio_ButtonInstance_e button, Gpio_ButtonEvent_e event)
+{
+    uint8_t head = hEvents.head;
+
+    if((uint8_t)(head - hEvents.tail) >= GPIO_EVENT_QUEUE_SIZE)
     {
-        pButton->counter  = GPIO_DEBOUNCE_TIME;
-        pButton->counting = true;
+        if(hEvents.lost != UINT8_MAX)
+        {
+            hEvents.lost++;
+        }
+        return;
     }
 
-    if(pButton->counting)
+    hEvents.events[GPIO_EVENT_INDEX(head)].time   = (uint16_t)timestamp;
+    hEvents.events[GPIO_EVENT_INDEX(head)].button = button;
+    hEvents.events[GPIO_EVENT_INDEX(head)].event  = event;
+
+    // the event is visible to the consumer only after it is complete
+    hEvents.head = head + 1;
+}
+
+/**
+ * @brief Arms INT0 once the button A is released and stable, swallows the press handled by the fast stop.
+ *
+ * After the fast stop, all changes of the button A are swallowed until it is released and stable, so neither its
+ * press nor its release makes an event, however long the button is held.
+ *
+ * @param pChanged mask of changed inputs, the button A is removed from it while it is swallowed
+ */
+static inline void Gpio_privPerformFastStop(uint8_t *pChanged)
+{
+    // released and the last sample is equal (the counter is not running)
+    bool released = !(hDebouncer.state & GPIO_BUTTON_A_MASK) &&
+                    (hDebouncer.count0 & hDebouncer.count1 & GPIO_BUTTON_A_MASK);
+
+    switch(hFastStop.state)
     {
-        if(pButton->counter == 0)
+    case eGPIO_FAST_STOP_PENDING:
+        if(released)
         {
-            pButton->debouncedValue = pButton->oldValue;
-            pButton->counting       = false;
-            changed                 = true;
+            // armed before the interrupt is enabled, the interrupt may come right away and trigger the stop
+            hFastStop.state = eGPIO_FAST_STOP_ARMED;
+            GIFR            = _BV(INTF0);
+            GICR |= _BV(INT0);
         }
-        else
+        break;
+    case eGPIO_FAST_STOP_TRIGGERED:
+        *pChanged &= ~GPIO_BUTTON_A_MASK;
+        if(released)
         {
-            pButton->counter--;
+            hFastStop.state = eGPIO_FAST_STOP_OFF;
         }
+        break;
+    default:
+        break;
     }
+}
 
-    pButton->oldValue = currentValue;
-
-    return changed;
+/**
+ * @brief Detects gestures of one button, called every tick with the debounced state.
+ *
+ * Only a counter is decremented when nothing happens, so the cost is the same every tick. Timing is configured in
+ * system_settings.h.
+ *
+ * @param instance button
+ * @param changed true if the debounced state has changed in this tick
+ * @param pressed debounced state, true = pressed
+ */
+static inline void Gpio_privPerformGesture(Gpio_ButtonInstance_e instance, bool changed, bool pressed)
+{
+    Gpio_Gesture_t *pGesture = &hGesture[instance];
 
-    /* Another implementation:
-    if(pButton->oldValue != currentValue)
+    if(changed)
     {
-    pButton->oldValue = currentValue;
-    pButton->counter  = GPIO_DEBOUNCE_TIME;
+        Gpio_privPushEvent(instance, pressed ? eBUTTON_EVENT_PRESSED : eBUTTON_EVENT_RELEASED);
+
+        if(pressed && (pGesture->state == eGPIO_GESTURE_STATE_CLICKED))
+        {
+            Gpio_privPushEvent(instance, eBUTTON_EVENT_DOUBLE_CLICK);
+            pGesture->state = eGPIO_GESTURE_STATE_SECOND;
+        }
+        else if(pressed)
+        {
+            pGesture->state = eGPIO_GESTURE_STATE_PRESSED;
+            pGesture->ticks = GPIO_LONG_PRESS_TIME;
+        }
+        else if(pGesture->state == eGPIO_GESTURE_STATE_PRESSED)
+        {
+            pGesture->state = eGPIO_GESTURE_STATE_CLICKED;
+            pGesture->ticks = GPIO_DOUBLE_CLICK_TIME;
+        }
+        else
+        {
+            pGesture->state = eGPIO_GESTURE_STATE_IDLE;
+        }
+        return;
     }
 
-    if((pButton->counter) == 0)
+    if((pGesture->state == eGPIO_GESTURE_STATE_IDLE) || (pGesture->state == eGPIO_GESTURE_STATE_SECOND) ||
+       (--pGesture->ticks != 0))
     {
-    pButton->debouncedValue = pButton->oldValue;
-    pButton->ValidCounter = GPIO_VALID_COUNTER;
+        return;
     }
 
-    if(pButton->ValidCounter)
+    switch(pGesture->state)
     {
-    pButton->ValidCounter--;
+    case eGPIO_GESTURE_STATE_PRESSED:
+        Gpio_privPushEvent(instance, eBUTTON_EVENT_LONG_PRESS);
+        pGesture->state  = eGPIO_GESTURE_STATE_REPEATING;
+        pGesture->period = GPIO_REPEAT_PERIOD;
+        pGesture->ticks  = GPIO_REPEAT_PERIOD;
+        break;
+    case eGPIO_GESTURE_STATE_REPEATING:
+        // each repeat comes sooner until the minimal period is reached
+        Gpio_privPushEvent(instance, eBUTTON_EVENT_REPEAT);
+        pGesture->period -= pGesture->period >> GPIO_REPEAT_ACCELERATION;
+        if(pGesture->period < GPIO_REPEAT_PERIOD_MIN)
+        {
+            pGesture->period = GPIO_REPEAT_PERIOD_MIN;
+        }
+        pGesture->ticks = pGesture->period;
+        break;
+    default: // no second press in time, it was a single click
+        pGesture->state = eGPIO_GESTURE_STATE_IDLE;
+        break;
     }
-    
-    pButton->counter--;
-    */
 }
 
 //===================================================================================================================//
@@ -138,26 +255,25 @@ static bool Gpio_privDebounce(Gpio_Debouncer_t *pButton, uint8_t currentValue)
 //===================================================================================================================//
 
 /**
- * @brief Performs debouncing of buttons.
+ * @brief Performs debouncing of buttons and detection of their gestures.
  *
- * At best run it periodically.
+ * The input port is sampled once and all buttons are debounced together. Intended to be called from the system tick
+ * interrupt.
  *
  */
 void Gpio_ButtonsPerform()
 {
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
-    {
-        if(Gpio_privDebounce(&hButton[eGPIO_BUTTON_A].debounce, hButton[eGPIO_BUTTON_A].input))
-        {
-            hButton[eGPIO_BUTTON_A].status =
-                (hButton[eGPIO_BUTTON_A].input == GPIO_INPUT_BUTTON_LEVEL_ON) ? eBUTTON_STATUS_PRESSED : eBUTTON_STATUS_RELEASED;
-        }
-        if(Gpio_privDebounce(&hButton[eGPIO_BUTTON_B].debounce, hButton[eGPIO_BUTTON_B].input))
-        {
-            hButton[eGPIO_BUTTON_B].status =
-                (hButton[eGPIO_BUTTON_B].input == GPIO_INPUT_BUTTON_LEVEL_ON) ? eBUTTON_STATUS_PRESSED : eBUTTON_STATUS_RELEASED;
-        }
-    }
+    // buttons are active low
+    uint8_t changed = Gpio_privDebounce(&hDebouncer, (uint8_t)~GPIO_BUTTON_PIN & GPIO_BUTTONS_MASK);
+
+    Gpio_privPerformFastStop(&changed);
+
+    Gpio_privPerformGesture(eGPIO_BUTTON_A,
+                            (changed & GPIO_BUTTON_A_MASK) ? true : false,
+                            (hDebouncer.state & GPIO_BUTTON_A_MASK) ? true : false);
+    Gpio_privPerformGesture(eGPIO_BUTTON_B,
+                            (changed & GPIO_BUTTON_B_MASK) ? true : false,
+                            (hDebouncer.state & GPIO_BUTTON_B_MASK) ? true : false);
 }
 
 /**
@@ -190,28 +306,97 @@ void Gpio_InitAll()
     DDRD  = 0xF1;
     PORTD = 0xFE;
 
-    // Initialize interrupts for buttons
-    MCUCR |= _BV(ISC10) | _BV(ISC00);
-    GICR |= _BV(INT0) | _BV(INT1);
+    // Buttons are polled in Gpio_ButtonsPerform, INT0 is enabled only by the fast stop
+}
+
+/**
+ * @brief Takes the oldest button event from the queue.
+ *
+ * Only one caller (the main loop) may take the events. Indexes are single bytes, so no interrupt lock is needed.
+ *
+ * @param pEvent place for the event
+ * @return true if there was an event, false if the queue is empty
+ */
+bool Gpio_GetEvent(Gpio_ButtonEvent_t *pEvent)
+{
+    uint8_t tail = hEvents.tail;
+
+    if(tail == hEvents.head)
+    {
+        return false;
+    }
+
+    pEvent->time   = hEvents.events[GPIO_EVENT_INDEX(tail)].time;
+    pEvent->button = hEvents.events[GPIO_EVENT_INDEX(tail)].button;
+    pEvent->event  = hEvents.events[GPIO_EVENT_INDEX(tail)].event;
+
+    // the slot is released to the producer only after it is read
+    hEvents.tail = tail + 1;
+
+    return true;
 }
 
 /**
- * @brief Return current status of button
+ * @brief Returns the number of events lost because the queue was full and resets it.
  *
- * Available statuses are Pressed, Release, Idle. If it was pressed or release and this function was called, the status
- * gets back to idle. It takes the debounced value.
+ * @return number of lost events, saturates at UINT8_MAX
+ */
+uint8_t Gpio_GetLostEvents()
+{
+    uint8_t lost;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        lost         = hEvents.lost;
+        hEvents.lost = 0;
+    }
+
+    return lost;
+}
+
+/**
+ * @brief Arms or disarms the fast stop by the button A.
  *
- * @param pButton pointer to the Button object.
- * @return Idle, Pressed, Released.
+ * When armed, INT0 is enabled as soon as the button A is released. The first falling edge with the button still held
+ * in the interrupt calls Gpio_FastStopCallback directly from INT0, without waiting for the debouncing and the main
+ * loop. The button A makes no events until it is released, as its press was already handled by the fast stop.
+ *
+ * @param arm true to arm, false to disarm
+ */
+void Gpio_FastStopArm(bool arm)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        GICR &= ~_BV(INT0);
+        if(arm)
+        {
+            // falling edge
+            MCUCR               = (MCUCR & ~_BV(ISC00)) | _BV(ISC01);
+            hFastStop.state     = eGPIO_FAST_STOP_PENDING;
+            hFastStop.triggered = false;
+        }
+        else if(hFastStop.state != eGPIO_FAST_STOP_TRIGGERED)
+        {
+            // a triggered stop still has to swallow its press
+            hFastStop.state = eGPIO_FAST_STOP_OFF;
+        }
+    }
+}
+
+/**
+ * @brief Returns true once after the fast stop was triggered.
  */
-Gpio_ButtonStatus_e Gpio_GetButton(Gpio_Button_t *pButton)
+bool Gpio_IsFastStopped()
 {
-    Gpio_ButtonStatus_e current = pButton->status;
+    bool triggered;
 
-    // reset it
-    pButton->status = eBUTTON_STATUS_IDLE;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        triggered           = hFastStop.triggered;
+        hFastStop.triggered = false;
+    }
 
-    return current;
+    return triggered;
 }
 
 //===================================================================================================================//
@@ -220,31 +405,12 @@ Gpio_ButtonStatus_e Gpio_GetButton(Gpio_Button_t *pButton)
 
 static void Gpio_privEnableLedAll()
 {
-    GPIO_OUT_LED_A_ENABLE();
-    GPIO_OUT_LED_B_ENABLE();
-    GPIO_OUT_LED_C_ENABLE();
-
-    GPIO_SEG_RIGHT_ENABLE();
-    GPIO_SEG_LEFT_ENABLE();
-
-    GPIO_OUT_SEG_A_ENABLE();
-    GPIO_OUT_SEG_B_ENABLE();
-    GPIO_OUT_SEG_C_ENABLE();
-    GPIO_OUT_SEG_D_ENABLE();
-
-    GPIO_OUT_SEG_E_ENABLE();
-    GPIO_OUT_SEG_F_ENABLE();
-    GPIO_OUT_SEG_G_ENABLE();
-    GPIO_OUT_SEG_DP_ENABLE();
+    GPIO_GROUP_APPLY(GPIO_GROUP_DIGITS, GPIO_GROUP_LIGHTS);
 }
 
 static void Gpio_privDisableLedAll()
 {
-    PORTB |= 0xE0;
-    PORTC |= 0x3C;
-    PORTD |= 0xF0;
-
-    PORTB &= ~(0x05);
+    GPIO_GROUP_APPLY(GPIO_GROUP_LIGHTS, GPIO_GROUP_DIGITS);
 }
 
 static void Gpio_privEnableSegmentLEDs()
@@ -21,14 +21,12 @@
 
 // Target specific includes
 #include <avr/io.h>
+#include <util/atomic.h>
 
 //===================================================================================================================//
 // Public defines                                                                                                    //
 //===================================================================================================================//
 
-#define GPIO_BUTTON_A (&hButton[eGPIO_BUTTON_A])
-#define GPIO_BUTTON_B (&hButton[eGPIO_BUTTON_B])
-
 //===================================================================================================================//
 // Public typedefs                                                                                                   //
 //===================================================================================================================//
@@ -40,30 +38,82 @@ typedef enum
 } Gpio_ButtonInstance_e;
 typedef enum
 {
-    eBUTTON_STATUS_IDLE,
-    eBUTTON_STATUS_PRESSED,
-    eBUTTON_STATUS_RELEASED
-} Gpio_ButtonStatus_e;
+    eBUTTON_EVENT_NONE,
+    eBUTTON_EVENT_PRESSED,
+    eBUTTON_EVENT_RELEASED,
+    eBUTTON_EVENT_LONG_PRESS,  // held for GPIO_LONG_PRESS_TIME, repeats follow while it is held
+    eBUTTON_EVENT_REPEAT,      // held, reported with a period shortening from GPIO_REPEAT_PERIOD
+    eBUTTON_EVENT_DOUBLE_CLICK // pressed again within GPIO_DOUBLE_CLICK_TIME after a short press
+} Gpio_ButtonEvent_e;
+typedef enum
+{
+    eGPIO_GESTURE_STATE_IDLE,
+    eGPIO_GESTURE_STATE_PRESSED,   // waiting for the long press
+    eGPIO_GESTURE_STATE_CLICKED,   // released after a short press, waiting for the second press
+    eGPIO_GESTURE_STATE_SECOND,    // second press of the double click, waiting for the release
+    eGPIO_GESTURE_STATE_REPEATING  // long press, repeating until the release
+} Gpio_GestureState_e;
+
+typedef enum
+{
+    eGPIO_FAST_STOP_OFF,
+    eGPIO_FAST_STOP_PENDING,  // waiting for the button A to be released
+    eGPIO_FAST_STOP_ARMED,    // INT0 is enabled
+    eGPIO_FAST_STOP_TRIGGERED // the button A is swallowed until it is released
+} Gpio_FastStopState_e;
 
-typedef volatile struct
+/**
+ * @brief Vertical counter debouncer, one bit per input of the sampled port
+ */
+typedef struct
 {
-    uint8_t oldValue;
-    uint8_t debouncedValue;
-    uint8_t counter;
-    bool    counting;
+    uint8_t state;  // debounced inputs, 1 = pressed
+    uint8_t count0; // low bit of the per-input counters
+    uint8_t count1; // high bit of the per-input counters
 } Gpio_Debouncer_t;
-typedef volatile struct
+/**
+ * @brief Gesture detection of one button, driven by the system tick
+ */
+typedef struct
+{
+    Gpio_GestureState_e state;
+    uint16_t            ticks;  // remaining ticks of the current state
+    uint16_t            period; // current repeat period in ticks
+} Gpio_Gesture_t;
+/**
+ * @brief One button event, the time is the low part of the system timestamp
+ */
+typedef struct
+{
+    uint16_t              time; // system ticks
+    Gpio_ButtonInstance_e button;
+    Gpio_ButtonEvent_e    event;
+} Gpio_ButtonEvent_t;
+/**
+ * @brief Single producer (system tick) single consumer (main loop) queue of button events
+ *
+ * Head is written only by the producer and tail only by the consumer, both are free running.
+ */
+typedef struct
+{
+    Gpio_ButtonEvent_t events[GPIO_EVENT_QUEUE_SIZE];
+    uint8_t            head;
+    uint8_t            tail;
+    uint8_t            lost; // events not stored because the queue was full, saturates
+} Gpio_EventQueue_t;
+/**
+ * @brief Fast stop by the button A, see Gpio_FastStopArm
+ */
+typedef struct
 {
-    Gpio_Debouncer_t    debounce;
-    Gpio_ButtonStatus_e status;
-    bool                input;
-} Gpio_Button_t;
+    Gpio_FastStopState_e state;
+    bool                 triggered; // reported to the application
+} Gpio_FastStop_t;
 
 //===================================================================================================================//
 // Public variables                                                                                                  //
 //===================================================================================================================//
 
-extern Gpio_Button_t hButton[2];
 //===================================================================================================================//
 // Macro for pin manipulation                                                                                        //
 //===================================================================================================================//
@@ -78,6 +128,19 @@ extern Gpio_Button_t hButton[2];
 #define TOGGLE_(what, p, m)       GLUE(what, p) ^= (1 << (m))
 #define TOGGLE(what, x)           TOGGLE_(what, x)
 
+// Compile time pin information, usable in #if
+#define GPIO_PORT_ID_B            0
+#define GPIO_PORT_ID_C            1
+#define GPIO_PORT_ID_D            2
+#define PIN_PORT_ID_(p, m)        GLUE(GPIO_PORT_ID_, p)
+#define PIN_PORT_ID(...)          PIN_PORT_ID_(__VA_ARGS__)
+#define PIN_MASK_(p, m)           (1 << (m))
+#define PIN_MASK(...)             PIN_MASK_(__VA_ARGS__)
+#define PIN_REG_(what, p, m)      GLUE(what, p)
+#define PIN_REG(what, ...)        PIN_REG_(what, __VA_ARGS__)
+#define PIN_MASK_ON_PORT(port, ...)                                                                                    \
+    ((PIN_PORT_ID(__VA_ARGS__) == GLUE(GPIO_PORT_ID_, port)) ? PIN_MASK(__VA_ARGS__) : 0)
+
 //===================================================================================================================//
 // GPIO configuration macros                                                                                         //
 //===================================================================================================================//
@@ -95,6 +158,7 @@ extern Gpio_Button_t hButton[2];
 // OUT, OUT_KEY
 #define GPIO_OUT_KEY_ENABLE()     SET(PORT, OUT_KEY)
 #define GPIO_OUT_KEY_DISABLE()    CLR(PORT, OUT_KEY)
+#define GPIO_IN_GET_OUT_KEY()     GET(OUT_KEY)
 
 // OUT, DC_DC_KEY
 #define GPIO_OUT_DC_DC_ENABLE()   SET(PORT, DC_DC_KEY)
@@ -132,6 +196,9 @@ extern Gpio_Button_t hButton[2];
 
 // PORT D
 
+// IN, UART_RX
+#define GPIO_IN_GET_UART_RX()     GET(UART_RX)
+
 // IN, SWITCH_A
 #define GPIO_IN_GET_SWITCH_A()    GET(SWITCH_A)
 
@@ -154,6 +221,54 @@ extern Gpio_Button_t hButton[2];
 #define GPIO_OUT_SEG_DP_ENABLE()  CLR(PORT, SEG_DP)
 #define GPIO_OUT_SEG_DP_DISABLE() SET(PORT, SEG_DP)
 
+//===================================================================================================================//
+// GPIO group macros                                                                                                 //
+//===================================================================================================================//
+
+// A group is a macro giving the mask of its pins on the given port (B, C or D), computed from pinConfig.h
+#define GPIO_GROUP_NONE(port)     0
+#define GPIO_GROUP_LEDS(port)                                                                                          \
+    (PIN_MASK_ON_PORT(port, LED_A) | PIN_MASK_ON_PORT(port, LED_B) | PIN_MASK_ON_PORT(port, LED_C))
+#define GPIO_GROUP_SEGMENTS(port)                                                                                      \
+    (PIN_MASK_ON_PORT(port, SEG_A) | PIN_MASK_ON_PORT(port, SEG_B) | PIN_MASK_ON_PORT(port, SEG_C) |                   \
+     PIN_MASK_ON_PORT(port, SEG_D) | PIN_MASK_ON_PORT(port, SEG_E) | PIN_MASK_ON_PORT(port, SEG_F) |                   \
+     PIN_MASK_ON_PORT(port, SEG_G) | PIN_MASK_ON_PORT(port, SEG_DP))
+#define GPIO_GROUP_DIGITS(port)   (PIN_MASK_ON_PORT(port, SEG_LEFT) | PIN_MASK_ON_PORT(port, SEG_RIGHT))
+#define GPIO_GROUP_KEYS(port)     (PIN_MASK_ON_PORT(port, OUT_KEY) | PIN_MASK_ON_PORT(port, DC_DC_KEY))
+#define GPIO_GROUP_LIGHTS(port)   (GPIO_GROUP_LEDS(port) | GPIO_GROUP_SEGMENTS(port))
+
+#define GPIO_GROUP_PORT_APPLY_(port, setGroup, clrGroup)                                                               \
+    if((setGroup(port) | clrGroup(port)) != 0)                                                                         \
+    {                                                                                                                  \
+        GLUE(PORT, port) = (GLUE(PORT, port) & ~(clrGroup(port))) | (setGroup(port));                                  \
+    }
+
+/**
+ * @brief Sets pins of one group and clears pins of the other one, each port is written once.
+ *
+ * Masks are constant, so ports without any pin of the groups are not touched at all. The ports are written with
+ * interrupts disabled, so an interrupt changing other pins of the same port can not be overwritten.
+ */
+#define GPIO_GROUP_APPLY(setGroup, clrGroup)                                                                           \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)                                                                              \
+        {                                                                                                              \
+            GPIO_GROUP_PORT_APPLY_(B, setGroup, clrGroup)                                                              \
+            GPIO_GROUP_PORT_APPLY_(C, setGroup, clrGroup)                                                              \
+            GPIO_GROUP_PORT_APPLY_(D, setGroup, clrGroup)                                                              \
+        }                                                                                                              \
+    } while(0)
+#define GPIO_GROUP_SET(group)     GPIO_GROUP_APPLY(group, GPIO_GROUP_NONE)
+#define GPIO_GROUP_CLR(group)     GPIO_GROUP_APPLY(GPIO_GROUP_NONE, group)
+
+// OUT, LEDs (active low)
+#define GPIO_OUT_LEDS_ENABLE()    GPIO_GROUP_CLR(GPIO_GROUP_LEDS)
+#define GPIO_OUT_LEDS_DISABLE()   GPIO_GROUP_SET(GPIO_GROUP_LEDS)
+
+// OUT, keys of the output and the dc-dc converter
+#define GPIO_OUT_KEYS_DISABLE()   GPIO_GROUP_CLR(GPIO_GROUP_KEYS)
+
 //===================================================================================================================//
 // Public Functions                                                                                                  //
 //===================================================================================================================//
@@ -161,7 +276,7 @@ extern Gpio_Button_t hButton[2];
 /**
  * @brief Performs debouncing of buttons.
  *
- * At best run it periodically.
+ * Run it periodically, a button changes its state after GPIO_DEBOUNCE_TIME equal samples.
  *
  */
 void Gpio_ButtonsPerform();
@@ -177,15 +292,45 @@ void Gpio_ButtonsPerform();
 void Gpio_InitAll();
 
 /**
- * @brief Return current status of button
+ * @brief Takes the oldest button event from the queue.
+ *
+ * Only one caller (the main loop) may take the events.
+ *
+ * @param pEvent place for the event
+ * @return true if there was an event, false if the queue is empty
+ */
+bool Gpio_GetEvent(Gpio_ButtonEvent_t *pEvent);
+
+/**
+ * @brief Returns the number of events lost because the queue was full and resets it.
+ *
+ * @return number of lost events, saturates at UINT8_MAX
+ */
+uint8_t Gpio_GetLostEvents();
+
+/**
+ * @brief Arms or disarms the fast stop by the button A.
+ *
+ * When armed, INT0 is enabled as soon as the button A is released. The first falling edge with the button still held
+ * in the interrupt calls Gpio_FastStopCallback directly from INT0, without waiting for the debouncing and the main
+ * loop. The button A makes no events until it is released, as its press was already handled by the fast stop.
+ *
+ * @param arm true to arm, false to disarm
+ */
+void Gpio_FastStopArm(bool arm);
+
+/**
+ * @brief Returns true once after the fast stop was triggered.
+ */
+bool Gpio_IsFastStopped();
+
+/**
+ * @brief Callback function for the fast stop, called from INT0.
  *
- * Available statuses are Pressed, Release, Idle. If it was pressed or release and this function was called, the status
- * gets back to idle. It takes the debounced value.
+ * Put the outputs into safe state here, keep it short.
  *
- * @param pButton pointer to the Button object.
- * @return Idle, Pressed, Released.
  */
-Gpio_ButtonStatus_e Gpio_GetButton(Gpio_Button_t *pButton);
+void Gpio_FastStopCallback();
 
 /**
  * @brief Function which enables sequentally all leds to check if they are all working
@@ -35,7 +35,7 @@
 // #define RESET      C, 6 // IN
 
 // PORT D
-// #define UART_RX    D, 0
+#define UART_RX    D, 0 // IN
 // #define UART_TX    D, 1
 #define SWITCH_A   D, 2 // IN
 #define SWITCH_B   D, 3 // IN
@@ -44,4 +44,9 @@
 #define SEG_G      D, 6 // OUT
 #define SEG_DP     D, 7 // OUT
 
+// Display digits (common anodes) from the left, segments are SEG_A to SEG_DP
+#define DISPLAY_DIGIT_COUNT 2
+#define DISPLAY_DIGIT_0     SEG_LEFT
+#define DISPLAY_DIGIT_1     SEG_RIGHT
+
 #endif // PIN_CONFIG_H_
\ No newline at end of file
@@ -27,6 +27,7 @@
 // Target specific includes
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <util/atomic.h>
 
 //===================================================================================================================//
 // Private macro defines                                                                                             //
@@ -102,6 +103,16 @@ ISR(TIMER0_OVF_vect)
     TimerHAL_Timer0_OverflowCallback();
 }
 
+__weak void TimerHAL_Timer2_CompareCallback()
+{
+    ;
+}
+
+ISR(TIMER2_COMP_vect)
+{
+    TimerHAL_Timer2_CompareCallback();
+}
+
 //===================================================================================================================//
 // Public functions                                                                                                  //
 //===================================================================================================================//
@@ -247,6 +258,33 @@ bool TimerHAL_IsTimerEnabled(Timer_index_e timer)
     return false;
 }
 
+/**
+ * @brief Returns time in clocks of timer 0, intended for measuring of short durations.
+ *
+ * The value wraps around after 256 system ticks.
+ *
+ * @return time in TIMER_HAL_FINE_TIME_US units
+ */
+uint16_t TimerHAL_GetFineTime()
+{
+    uint8_t ticks;
+    uint8_t counter;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks   = (uint8_t)timestamp;
+        counter = TCNT0;
+
+        // overflow which was not served yet, the counter has already wrapped around
+        if((TIFR & _BV(TOV0)) && (counter < 128))
+        {
+            ticks++;
+        }
+    }
+
+    return ((uint16_t)ticks << 8) | counter;
+}
+
 /**
  * @brief Changes Output compare value for specific timer
  *
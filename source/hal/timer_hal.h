@@ -31,6 +31,16 @@
 // Public macro defines                                                                                              //
 //===================================================================================================================//
 
+/**
+ * @brief Period of the system tick (timer 0 overflow, prescaler 64) in microseconds
+ */
+#define TIMER_HAL_SYSTICK_PERIOD_US ((64UL * 256UL * 1000UL) / (F_CPU / 1000UL))
+
+/**
+ * @brief Resolution of TimerHAL_GetFineTime (one clock of timer 0) in microseconds
+ */
+#define TIMER_HAL_FINE_TIME_US      ((64UL * 1000UL) / (F_CPU / 1000UL))
+
 //===================================================================================================================//
 // Public definitions                                                                                                //
 //===================================================================================================================//
@@ -106,24 +116,80 @@ extern volatile uint32_t timestamp;
  * The OCR is toggling each time of timer overflow
  *
  */
-#define TIMER_HAL_ENABLE_OCR1()  TCCR1A |= _BV(COM1B1)
+#define TIMER_HAL_ENABLE_OCR1()            TCCR1A |= _BV(COM1B1)
 
 /**
  * @brief Disables OCR output for Timer 1
- * The OCR is toggling each time of timer overflow
+ * The pin OC1B is driven by its port value again
  *
  */
-#define TIMER_HAL_DISABLE_OCR1() TCCR1A &= ~_BV(COM1A0)
+#define TIMER_HAL_DISABLE_OCR1()           TCCR1A &= ~(_BV(COM1B1) | _BV(COM1B0))
 
 /**
  * @brief Enables OCR output for Timer 2
+ * The OCR is toggling on each compare match
  */
-#define TIMER_HAL_ENABLE_OCR2()  TCCR2 |= _BV(COM20)
+#define TIMER_HAL_ENABLE_OCR2()            TCCR2 = (TCCR2 & ~_BV(COM21)) | _BV(COM20)
 
 /**
  * @brief Disables OCR output for Timer 2
  */
-#define TIMER_HAL_DISABLE_OCR2() TCCR2 &= ~(_BV(COM20))
+#define TIMER_HAL_DISABLE_OCR2()           TCCR2 &= ~(_BV(COM21) | _BV(COM20))
+
+/**
+ * @brief Enables OCR output for Timer 2, the OCR is set (true) or cleared (false) on the next compare match
+ */
+#define TIMER_HAL_SET_OCR2_ON_COMPARE(high)                                                                            \
+    TCCR2 = (TCCR2 & ~(_BV(COM21) | _BV(COM20))) | _BV(COM21) | ((high) ? _BV(COM20) : 0)
+
+/**
+ * @brief Enables OCR output for Timer 2 in fast PWM mode, cleared on compare match and set at the bottom
+ */
+#define TIMER_HAL_ENABLE_OCR2_PWM()        TCCR2 = (TCCR2 & ~_BV(COM20)) | _BV(COM21)
+
+/**
+ * @brief Switches timer 2 between CTC (the output frequency given by OCR) and fast PWM (TOP is 0xFF)
+ */
+#define TIMER_HAL_SET_TIMER2_CTC()         TCCR2 = (TCCR2 & ~_BV(WGM20)) | _BV(WGM21)
+#define TIMER_HAL_SET_TIMER2_FAST_PWM()    TCCR2 |= _BV(WGM20) | _BV(WGM21)
+
+/**
+ * @brief Writes OCR value of timer 2 directly, intended for use in ISR
+ */
+#define TIMER_HAL_SET_OCR2(value)          OCR2 = (value)
+#define TIMER_HAL_GET_OCR2()               OCR2
+
+/**
+ * @brief Reads and writes counter of timer 2. Writing blocks the compare match in the next timer clock.
+ */
+#define TIMER_HAL_GET_TCNT2()              TCNT2
+#define TIMER_HAL_SET_TCNT2(value)         TCNT2 = (value)
+
+/**
+ * @brief Forces compare match output action of timer 2, the counter is not cleared
+ */
+#define TIMER_HAL_FORCE_OCR2()             TCCR2 |= _BV(FOC2)
+
+/**
+ * @brief Compare match flag of timer 2, used when the compare match is polled
+ */
+#define TIMER_HAL_IS_OCR2_FLAG()           (TIFR & _BV(OCF2))
+#define TIMER_HAL_CLEAR_OCR2_FLAG()        TIFR = _BV(OCF2)
+
+/**
+ * @brief Enables compare match interrupt for Timer 2
+ */
+#define TIMER_HAL_ENABLE_OCR2_INTERRUPT()  TIMSK |= _BV(OCIE2)
+
+/**
+ * @brief Checks if compare match interrupt for Timer 2 is enabled
+ */
+#define TIMER_HAL_IS_OCR2_INTERRUPT()      (TIMSK & _BV(OCIE2))
+
+/**
+ * @brief Disables compare match interrupt for Timer 2
+ */
+#define TIMER_HAL_DISABLE_OCR2_INTERRUPT() TIMSK &= ~(_BV(OCIE2))
 
 /**
  * @brief Callback function for timer 0 overlow.
@@ -133,6 +199,15 @@ extern volatile uint32_t timestamp;
  */
 void TimerHAL_Timer0_OverflowCallback();
 
+/**
+ * @brief Callback function for timer 2 compare match.
+ *
+ * It is called only if the compare match interrupt is enabled. Keep it as short as possible, as it can be called
+ * even every few dozens of cpu cycles.
+ *
+ */
+void TimerHAL_Timer2_CompareCallback();
+
 /**
  * @brief Initializes timer 0, 1 or 2
  *
@@ -165,6 +240,15 @@ void TimerHAL_StartTimer(Timer_index_e timer);
  */
 bool TimerHAL_IsTimerEnabled(Timer_index_e timer);
 
+/**
+ * @brief Returns time in clocks of timer 0, intended for measuring of short durations.
+ *
+ * The value wraps around after 256 system ticks.
+ *
+ * @return time in TIMER_HAL_FINE_TIME_US units
+ */
+uint16_t TimerHAL_GetFineTime();
+
 /**
  * @brief Changes Output compare value for specific timer
  *
@@ -0,0 +1,142 @@
+import argparse
+import re
+import sys
+
+# Generates table for the control input battery compensation from calibration points.
+# The piecewise-linear calibration curve is resampled onto a grid with a power of two spacing, so the driver
+# interpolates with a shift and a mask only:
+#   i = (v - V0) >> SHIFT,  f = (v - V0) & (2^SHIFT - 1),  y = y[i] + ((y[i+1] - y[i]) * f + 2^(SHIFT-1)) >> SHIFT
+# The widest spacing which keeps the error against the calibration curve within the allowed limit is chosen.
+# The build fails if there is none, or if the interpolation could overflow 16 bit arithmetic.
+
+MAX_SHIFT = 8
+MAX_ADC_VALUE = 1023
+
+parser = argparse.ArgumentParser(description="Generator of output driver battery compensation table")
+parser.add_argument("--calibration", required=True, help="path to csv file with calibration points")
+parser.add_argument("--settings", required=True, help="path to system_settings.h")
+parser.add_argument("--header", required=True, help="path to generated header")
+args = parser.parse_args()
+
+
+def get_setting(settings, name):
+    match = re.search(r"^\s*#define\s+" + name + r"\s+\(?(-?\d+)\)?", settings, re.MULTILINE)
+    if match is None:
+        sys.exit(f"ERROR: {name} not found in {args.settings}")
+    return int(match.group(1))
+
+
+def read_points(path):
+    points = []
+    with open(path, "r") as f:
+        for number, line in enumerate(f, 1):
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            try:
+                voltage, value = (int(item) for item in line.split(","))
+            except ValueError:
+                sys.exit(f"ERROR: {path}:{number}: expected 'voltage, value'")
+            if not 0 < value <= MAX_ADC_VALUE:
+                sys.exit(f"ERROR: {path}:{number}: value {value} out of adc range")
+            if points and voltage <= points[-1][0]:
+                sys.exit(f"ERROR: {path}:{number}: voltages must be increasing")
+            points.append((voltage, value))
+    if len(points) < 2:
+        sys.exit(f"ERROR: {path}: at least two calibration points are needed")
+    return points
+
+
+def curve(points, voltage):
+    if voltage <= points[0][0]:
+        return points[0][1]
+    if voltage >= points[-1][0]:
+        return points[-1][1]
+    for (x0, y0), (x1, y1) in zip(points, points[1:]):
+        if x0 <= voltage <= x1:
+            return y0 + (y1 - y0) * (voltage - x0) / (x1 - x0)
+
+
+def interpolate(table, shift, v0, voltage):
+    # Same arithmetic as OutputDriver_privGetControlInputMaxAdcValue
+    last = v0 + ((len(table) - 1) << shift) - 1
+    offset = min(max(voltage, v0), last) - v0
+    index = offset >> shift
+    fraction = offset & ((1 << shift) - 1)
+    delta = table[index + 1] - table[index]
+    return table[index] + ((delta * fraction + (1 << (shift - 1))) >> shift)
+
+
+def build(points, shift):
+    v0 = points[0][0]
+    size = -(-(points[-1][0] - v0) >> shift) + 1
+    table = [round(curve(points, v0 + (i << shift))) for i in range(size)]
+    error = max(abs(interpolate(table, shift, v0, v) - curve(points, v)) for v in range(0, 2 * points[-1][0]))
+    return table, error
+
+
+with open(args.settings, "r") as f:
+    settings = f.read()
+max_error = get_setting(settings, "OUTPUT_DRIVER_BATTERY_MAX_ERROR")  # adc counts
+points = read_points(args.calibration)
+
+best = None
+for shift in range(1, MAX_SHIFT + 1):
+    table, error = build(points, shift)
+    if error <= max_error:
+        best = (shift, table, error)
+if best is None:
+    sys.exit(f"ERROR: battery compensation error above {max_error} adc counts for every spacing")
+shift, table, error = best
+
+# Index and fraction are uint8_t in the driver
+if len(table) > 256:
+    sys.exit(f"ERROR: battery compensation table is too long ({len(table)} entries)")
+
+# Interpolation is done in int16_t, the product must fit
+worst_product = max(abs(b - a) for a, b in zip(table, table[1:])) * ((1 << shift) - 1) + (1 << (shift - 1))
+if worst_product > 32767:
+    sys.exit(f"ERROR: battery compensation interpolation overflows int16_t ({worst_product})")
+
+# ------ Header ------
+lines = []
+lines.append("/**")
+lines.append(" * @file output_driver_battery_table.h")
+lines.append(" *")
+lines.append(" * @brief Generated file with battery compensation of the control input. Do not edit!")
+lines.append(" *")
+lines.append(" * Generated by tools/generate_battery_table.py from:")
+lines.append(f" * {len(points)} calibration points, {points[0][0]}..{points[-1][0]} mV, error {error:.2f} adc counts")
+lines.append(" */")
+lines.append("")
+lines.append("#ifndef OUTPUT_DRIVER_BATTERY_TABLE_H_")
+lines.append("#define OUTPUT_DRIVER_BATTERY_TABLE_H_")
+lines.append("")
+lines.append(f"#define OUTPUT_DRIVER_BATTERY_TABLE_SIZE  {len(table)}")
+lines.append(f"#define OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE {points[0][0]}U // mV")
+lines.append(f"#define OUTPUT_DRIVER_BATTERY_SHIFT       {shift} // spacing of the table is {1 << shift} mV")
+lines.append("// Highest voltage which is interpolated, index + 1 is always inside the table")
+lines.append("#define OUTPUT_DRIVER_BATTERY_MAX_VOLTAGE \\")
+lines.append(
+    "    (OUTPUT_DRIVER_BATTERY_MIN_VOLTAGE + "
+    "((OUTPUT_DRIVER_BATTERY_TABLE_SIZE - 1U) << OUTPUT_DRIVER_BATTERY_SHIFT) - 1U)"
+)
+lines.append("")
+lines.append("/**")
+lines.append(" * @brief Maximum of the control input ADC value for the supply voltage given by the index.")
+lines.append(" * The table is stored in flash, read it with OUTPUT_DRIVER_BATTERY_TABLE_GET.")
+lines.append(" *")
+lines.append(" */")
+lines.append("const uint16_t outputDriver_BatteryTable[OUTPUT_DRIVER_BATTERY_TABLE_SIZE] PROGMEM = {")
+for row in range(0, len(table), 12):
+    lines.append("    " + " ".join(f"{value}," for value in table[row : row + 12]))
+lines[-1] = lines[-1].rstrip(",")
+lines.append("};")
+lines.append("")
+lines.append("#endif // OUTPUT_DRIVER_BATTERY_TABLE_H_")
+lines.append("")
+
+with open(args.header, "w") as f:
+    f.write("\n".join(lines))
+
+print(f"Output driver battery table: {len(table)} entries, {1 << shift} mV spacing, error {error:.2f} adc counts")
@@ -0,0 +1,260 @@
+import argparse
+import math
+import os
+import re
+import sys
+
+# Generates table with OCR and prescaler values for timer 2 (CTC mode, OC2 toggling on compare match).
+# Output frequency is then:  f = F_CPU / (2 * N * (OCR + 1))
+# For each frequency step the best pair of OCR and prescaler is chosen, together with a report of
+# the frequency error for every entry. The build fails if any entry is above the allowed error.
+#
+# Second table is for the PWM mode: whole period in timer ticks and prescaler, the interrupt splits
+# the period into the high and low part. Its report shows the duty range which the interrupt can make
+# and the fast PWM frequency used for the other duties, or that they are not possible.
+
+# Timer 2 prescalers as (CS2x bits value, division)
+TIMER_2_PRESCALERS = [(1, 1), (2, 8), (3, 32), (4, 64), (5, 128), (6, 256), (7, 1024)]
+TIMER_2_MAX_OCR = 255
+
+# PWM period is at most two full timer periods, so the interrupt runs about twice per output period
+PWM_MAX_PERIOD = 2 * (TIMER_2_MAX_OCR + 1)
+PWM_PERIOD_BITS = 10
+PWM_PRESCALER_SHIFT = 13
+
+parser = argparse.ArgumentParser(description="Generator of output driver frequency table")
+parser.add_argument("--f-cpu", type=int, required=True, help="CPU clock in Hz")
+parser.add_argument("--settings", required=True, help="path to system_settings.h")
+parser.add_argument("--header", required=True, help="path to generated header")
+parser.add_argument("--report", required=True, help="path to generated error report")
+args = parser.parse_args()
+
+
+def get_setting(settings, name):
+    match = re.search(r"^\s*#define\s+" + name + r"\s+([^/\n]+)", settings, re.MULTILINE)
+    if match is None:
+        sys.exit(f"ERROR: {name} not found in {args.settings}")
+    # a setting may be derived from other settings, C integer arithmetic only
+    expression = re.sub(r"[A-Za-z_]\w*", lambda m: str(get_setting(settings, m.group(0))), match.group(1))
+    if re.fullmatch(r"[\d\s()+*/-]+", expression) is None:
+        sys.exit(f"ERROR: {name} is not an integer expression")
+    return int(eval(expression.replace("/", "//")))
+
+
+def find_best_setting(f_cpu, frequency):
+    best = None
+    for bits, division in TIMER_2_PRESCALERS:
+        period = f_cpu / (2 * division * frequency)
+        # check both neighbouring ocr values, the closer period is not always the closer frequency
+        for ocr in (math.floor(period) - 1, math.ceil(period) - 1):
+            if ocr < 0 or ocr > TIMER_2_MAX_OCR:
+                continue
+            actual = f_cpu / (2 * division * (ocr + 1))
+            error = (actual - frequency) / frequency
+            # For the same error, the lower prescaler wins as it comes first
+            if best is None or abs(error) < abs(best[3]):
+                best = (ocr, bits, actual, error)
+    return best
+
+
+def find_pwm_setting(f_cpu, frequency):
+    # The lowest prescaler gives the best duty resolution
+    for bits, division in TIMER_2_PRESCALERS:
+        period = round(f_cpu / (division * frequency))
+        if period <= PWM_MAX_PERIOD:
+            actual = f_cpu / (division * period)
+            return (period, bits, actual, (actual - frequency) / frequency)
+    return None
+
+
+def find_fast_pwm_setting(f_cpu, frequency):
+    # Same as OutputDriver_SetPwm, hardware PWM period is 256 ticks and the closest frequency wins
+    best = None
+    for bits, division in TIMER_2_PRESCALERS:
+        actual = f_cpu // (256 * division)
+        error = (actual - frequency) / frequency
+        if best is None or abs(error) < abs(best[2]):
+            best = (division, actual, error)
+    return best
+
+
+def pwm_duty_range(period, division, min_cycles):
+    # Same rounding as OutputDriver_SetPwm, both parts must leave time for the interrupt
+    duties = []
+    for duty in range(1, 100):
+        high = (period * duty + 50) // 100
+        if high * division >= min_cycles and (period - high) * division >= min_cycles:
+            duties.append(duty)
+    return (duties[0], duties[-1]) if duties else None
+
+
+with open(args.settings, "r") as f:
+    settings = f.read()
+
+min_frequency = get_setting(settings, "OUTPUT_DRIVER_MIN_FREQUENCY")  # kHz
+max_frequency = get_setting(settings, "OUTPUT_DRIVER_MAX_FREQUENCY")  # kHz
+max_error = get_setting(settings, "OUTPUT_DRIVER_TABLE_MAX_ERROR")  # 0.1 %
+min_cycles = get_setting(settings, "OUTPUT_DRIVER_DITHER_MIN_CYCLES")
+
+if min_frequency < 1 or max_frequency < min_frequency:
+    sys.exit(f"ERROR: wrong frequency range {min_frequency}..{max_frequency} kHz")
+
+entries = []
+for frequency in range(min_frequency, max_frequency + 1):
+    best = find_best_setting(args.f_cpu, frequency * 1000)
+    if best is None:
+        sys.exit(f"ERROR: {frequency} kHz can not be generated by timer 2 with F_CPU = {args.f_cpu} Hz")
+    entries.append((frequency,) + best)
+
+pwm_entries = []
+for frequency in range(min_frequency, max_frequency + 1):
+    best = find_pwm_setting(args.f_cpu, frequency * 1000)
+    if best is None:
+        sys.exit(f"ERROR: PWM {frequency} kHz can not be generated by timer 2 with F_CPU = {args.f_cpu} Hz")
+    pwm_entries.append((frequency,) + best)
+
+# ------ Header ------
+lines = []
+lines.append("/**")
+lines.append(" * @file output_driver_freq_table.h")
+lines.append(" *")
+lines.append(" * @brief Generated file with ocr and prescaler values for timer 2. Do not edit!")
+lines.append(" *")
+lines.append(" * Generated by tools/generate_output_table.py for:")
+lines.append(f" * F_CPU = {args.f_cpu} Hz, frequency range {min_frequency}..{max_frequency} kHz")
+lines.append(" */")
+lines.append("")
+lines.append("#ifndef OUTPUT_DRIVER_FREQ_TABLE_H_")
+lines.append("#define OUTPUT_DRIVER_FREQ_TABLE_H_")
+lines.append("")
+lines.append(f"#define OUTPUT_DRIVER_TABLE_SIZE          {len(entries)}")
+lines.append(f"#define OUTPUT_DRIVER_TABLE_F_CPU         {args.f_cpu}UL")
+lines.append(f"#define OUTPUT_DRIVER_TABLE_MIN_FREQUENCY {min_frequency}")
+lines.append(f"#define OUTPUT_DRIVER_TABLE_MAX_FREQUENCY {max_frequency}")
+lines.append("")
+lines.append("#if (OUTPUT_DRIVER_TABLE_F_CPU != F_CPU)")
+lines.append("    #error \"Output driver table was generated for other F_CPU\"")
+lines.append("#endif")
+lines.append("#if (OUTPUT_DRIVER_TABLE_MIN_FREQUENCY != OUTPUT_DRIVER_MIN_FREQUENCY) || \\")
+lines.append("    (OUTPUT_DRIVER_TABLE_MAX_FREQUENCY != OUTPUT_DRIVER_MAX_FREQUENCY)")
+lines.append("    #error \"Output driver table was generated for other frequency range\"")
+lines.append("#endif")
+lines.append("")
+lines.append("/**")
+lines.append(" * @brief This table consists ocr and prescaler values for specific frequency.")
+lines.append(" * First row is the ocr")
+lines.append(" * Second row is the prescaler (timer 2 CS2x bits)")
+lines.append(" * The table is stored in flash, read it with OUTPUT_DRIVER_TABLE_GET_OCR/PRESCALER.")
+lines.append(" *")
+lines.append(" */")
+lines.append("const uint8_t outputDriver_table[OUTPUT_DRIVER_TABLE_SIZE][2] PROGMEM = {")
+for row in range(0, len(entries), 10):
+    items = [f"{{{e[1]}, {e[2]}}}," for e in entries[row : row + 10]]
+    lines.append("    " + " ".join(f"{item:9s}" for item in items).rstrip())
+lines[-1] = lines[-1].rstrip(",")
+lines.append("};")
+lines.append("")
+lines.append(f"#define OUTPUT_DRIVER_PWM_PERIOD_MASK     0x{(1 << PWM_PERIOD_BITS) - 1:04X}")
+lines.append(f"#define OUTPUT_DRIVER_PWM_PRESCALER_SHIFT {PWM_PRESCALER_SHIFT}")
+lines.append("")
+lines.append("/**")
+lines.append(" * @brief This table consists PWM period and prescaler values for specific frequency.")
+lines.append(" * Lower bits are the whole period in timer ticks, upper bits are the prescaler (timer 2 CS2x bits).")
+lines.append(" * The table is stored in flash, read it with OUTPUT_DRIVER_PWM_TABLE_GET_PERIOD/PRESCALER.")
+lines.append(" *")
+lines.append(" */")
+lines.append("const uint16_t outputDriver_pwmTable[OUTPUT_DRIVER_TABLE_SIZE] PROGMEM = {")
+for row in range(0, len(pwm_entries), 8):
+    items = [f"0x{(e[2] << PWM_PRESCALER_SHIFT) | e[1]:04X}," for e in pwm_entries[row : row + 8]]
+    lines.append("    " + " ".join(items))
+lines[-1] = lines[-1].rstrip(",")
+lines.append("};")
+lines.append("")
+lines.append("#endif // OUTPUT_DRIVER_FREQ_TABLE_H_")
+lines.append("")
+
+# ------ Report ------
+divisions = dict(TIMER_2_PRESCALERS)
+worst = max(entries, key=lambda e: abs(e[4]))
+
+# Duties out of the ISR range get fast PWM, if its frequency is close enough, see OutputDriver_SetPwm
+pwm_modes = []
+for frequency, period, bits, actual, error in pwm_entries:
+    duty = pwm_duty_range(period, divisions[bits], min_cycles)
+    fast = None
+    if duty is None or duty != (1, 99):
+        fast = find_fast_pwm_setting(args.f_cpu, frequency * 1000)
+        if abs(fast[2]) * 1000 > max_error:
+            fast = False
+    pwm_modes.append((duty, fast))
+
+# Only the frequencies which are really produced
+pwm_produced = []
+for (frequency, period, bits, actual, error), (duty, fast) in zip(pwm_entries, pwm_modes):
+    if duty is not None:
+        pwm_produced.append((frequency, error))
+    if fast:
+        pwm_produced.append((frequency, fast[2]))
+pwm_worst = max(pwm_produced, key=lambda e: abs(e[1]))
+pwm_impossible = [e[0] for e, (duty, fast) in zip(pwm_entries, pwm_modes) if duty is None and fast is False]
+
+report = []
+report.append(f"Output driver table report, F_CPU = {args.f_cpu} Hz")
+report.append(f"{'set [kHz]':>10} {'OCR':>5} {'presc.':>7} {'actual [Hz]':>13} {'error [%]':>10}")
+for frequency, ocr, bits, actual, error in entries:
+    report.append(f"{frequency:10d} {ocr:5d} {divisions[bits]:7d} {actual:13.1f} {100 * error:10.3f}")
+report.append(f"Worst error: {100 * worst[4]:.3f} % at {worst[0]} kHz")
+report.append("")
+report.append("PWM mode, ISR duties use the table, the other duties use fast PWM")
+report.append(
+    f"{'set [kHz]':>10} {'period':>7} {'presc.':>7} {'actual [Hz]':>13} {'error [%]':>10} {'ISR duty [%]':>13}"
+    f" {'fast [Hz]':>10} {'error [%]':>10}"
+)
+for (frequency, period, bits, actual, error), (duty, fast) in zip(pwm_entries, pwm_modes):
+    if duty is None:
+        isr = f"{'-':>13} {'-':>10} {'-':>13}"
+    else:
+        isr = f"{actual:13.1f} {100 * error:10.3f} {f'{duty[0]}..{duty[1]}':>13}"
+    if fast is None:
+        other = f"{'-':>10} {'-':>10}"
+    elif fast is False:
+        other = f"{'not possible':>21}"
+    else:
+        other = f"{fast[1]:10d} {100 * fast[2]:10.3f}"
+    report.append(f"{frequency:10d} {period:7d} {divisions[bits]:7d} {isr} {other}")
+report.append(f"Worst error: {100 * pwm_worst[1]:.3f} % at {pwm_worst[0]} kHz")
+if pwm_impossible:
+    report.append(f"Not possible except 0 and 100 % duty: {', '.join(str(f) for f in pwm_impossible)} kHz")
+report.append("")
+
+print(f"Output driver table: {len(entries)} entries, worst error {100 * worst[4]:.3f} % at {worst[0]} kHz")
+print(
+    f"Output driver PWM table: {len(pwm_entries)} entries, "
+    f"worst error {100 * pwm_worst[1]:.3f} % at {pwm_worst[0]} kHz, {len(pwm_impossible)} frequencies not possible"
+)
+
+# ------ Checks ------
+# Done before anything is written, an out of spec header must not be left newer than its inputs
+failed = []
+for frequency, ocr, bits, actual, error in entries:
+    if abs(error) * 1000 > max_error:
+        failed.append(f"ERROR: {frequency} kHz is generated as {actual:.1f} Hz ({100 * error:.3f} %)")
+# Fast PWM out of the limit is refused by OutputDriver_SetPwm, so only the ISR mode is checked
+for (frequency, period, bits, actual, error), (duty, fast) in zip(pwm_entries, pwm_modes):
+    if duty is not None and abs(error) * 1000 > max_error:
+        failed.append(f"ERROR: PWM {frequency} kHz is generated as {actual:.1f} Hz ({100 * error:.3f} %)")
+
+if failed:
+    print("\n".join(report), file=sys.stderr)
+    print("\n".join(failed), file=sys.stderr)
+    # outputs of a previous run would look up to date
+    for path in (args.header, args.report):
+        if os.path.exists(path):
+            os.remove(path)
+    sys.exit(f"ERROR: output frequency error above {max_error / 10} %")
+
+with open(args.header, "w") as f:
+    f.write("\n".join(lines))
+
+with open(args.report, "w") as f:
+    f.write("\n".join(report))
@@ -0,0 +1,103 @@
+import argparse
+import re
+import subprocess
+import sys
+
+# Prints memory usage of the application and the amount of RAM which is saved by keeping
+# constant tables in flash (PROGMEM). Without PROGMEM these tables would land in .data,
+# so they would take the same amount of RAM and be copied there at startup.
+# Only named tables are counted, PSTR strings and compiler jump tables are listed apart.
+# Fails if the application does not fit into the flash or RAM of the MCU.
+
+parser = argparse.ArgumentParser(description="Memory usage report for AVR application")
+parser.add_argument("--elf", required=True, help="path to the linked elf file")
+parser.add_argument("--map", required=True, help="path to the linker map file")
+parser.add_argument("--size", default="avr-size", help="avr-size executable")
+parser.add_argument("--ram", type=int, default=1024, help="RAM size of the MCU in bytes")
+parser.add_argument("--flash", type=int, default=8192, help="Flash size of the MCU in bytes")
+args = parser.parse_args()
+
+
+def get_section_sizes(elf):
+    sections = {}
+    output = subprocess.run([args.size, "-A", elf], capture_output=True, text=True, check=True).stdout
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".") and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    return sections
+
+
+def get_progmem_objects(map_file):
+    # Input sections in map file look like this (name can be wrapped to the next line):
+    #  .progmem.data.outputDriver_table
+    #                 0x00000026       0xc8 CMakeFiles/Zapper.dir/source/driver/output_driver.c.obj
+    objects = []
+    pattern = re.compile(r"^\s*(\.progmem\S*)\s*(0x[0-9a-fA-F]+)?\s*(0x[0-9a-fA-F]+)?")
+    with open(map_file, "r") as f:
+        lines = f.read().splitlines()
+
+    # only the memory map part is interesting, not the discarded sections
+    try:
+        start = next(i for i, line in enumerate(lines) if line.startswith("Linker script and memory map"))
+    except StopIteration:
+        start = 0
+
+    i = start
+    while i < len(lines):
+        match = pattern.match(lines[i])
+        if match and match.group(1) != ".progmem":
+            name = match.group(1)
+            size = match.group(3)
+            if size is None and i + 1 < len(lines):
+                next_fields = lines[i + 1].split()
+                if len(next_fields) >= 2 and next_fields[0].startswith("0x"):
+                    size = next_fields[1]
+                    i += 1
+            if size is not None and int(size, 16) > 0:
+                objects.append((name, int(size, 16)))
+        i += 1
+    return objects
+
+
+def is_table(section):
+    # Tables are named after their variable, PSTR strings are local variables named __c
+    if not section.startswith(".progmem.data."):
+        return False
+    return not section[len(".progmem.data.") :].startswith("__c")
+
+
+sections = get_section_sizes(args.elf)
+text = sections.get(".text", 0)
+data = sections.get(".data", 0)
+bss = sections.get(".bss", 0)
+noinit = sections.get(".noinit", 0)
+
+ram_used = data + bss + noinit
+flash_used = text + data
+
+print("========== Memory report ==========")
+print(f"Flash: {flash_used:6d} B of {args.flash} B ({100 * flash_used / args.flash:.1f} %)")
+print(f"RAM:   {ram_used:6d} B of {args.ram} B ({100 * ram_used / args.ram:.1f} %)"
+      f"  [.data {data} B, .bss {bss} B, .noinit {noinit} B]")
+
+objects = get_progmem_objects(args.map)
+tables = [(name[len(".progmem.data.") :], size) for name, size in objects if is_table(name)]
+others = sum(size for name, size in objects if not is_table(name))
+recovered = sum(size for _, size in tables)
+
+print("Constant tables kept in flash (RAM recovered):")
+for name, size in tables:
+    print(f"    {name:40s} {size:5d} B")
+print(f"Total RAM recovered: {recovered} B ({100 * recovered / args.ram:.1f} % of RAM)")
+print(f"Strings and jump tables in flash, not counted: {others} B")
+
+failed = False
+if flash_used > args.flash:
+    print(f"ERROR: flash is overfull by {flash_used - args.flash} B", file=sys.stderr)
+    failed = True
+if ram_used > args.ram:
+    print(f"ERROR: static RAM is overfull by {ram_used - args.ram} B", file=sys.stderr)
+    failed = True
+
+sys.exit(1 if failed else 0)